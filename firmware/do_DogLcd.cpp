@@ -49,41 +49,36 @@
  */
 
 #include "do_DogLcd.h"
+#include "do_DogLcd_hal.h"
 
-#if defined(SPARK)
-#include <application.h>
-#elif defined(ARDUINO) && ARDUINO >= 100
-#include <Arduino.h>
-#elif defined(ARDUINO)
-#include <WProgram.h>
-#endif
-
+#include <string.h>
 #if defined(ARDUINO)
 #include <stdio.h>
-#include <string.h>
 #include <inttypes.h>
-#include <SPI.h>
 #endif
 
 #if defined(SPARK)
 #define bitRead(value, bit) (((value) >> (bit)) & 0x01)
-#define theClockDivider SPI_CLOCK_DIV32
-#elif defined(ARDUINO)
-#define theClockDivider SPI_CLOCK_DIV4
 #endif
 
-DogLcdhw::DogLcdhw(int lcdSI, int lcdCLK, int lcdCSB, int lcdRS, int lcdRESET, int backLight) {
+/* commands like display control and entry mode work in every instruction table */
+#define ANY_TABLE 0xFF
+
+DogLcdhw::DogLcdhw(int lcdSI, int lcdCLK, int lcdCSB, int lcdRS, int lcdRESET, int backLight,
+                   uint32_t spiClock, int spiMode) {
     // select Hardware SPI by setting lcdSI == lcdCLK
     if (lcdSI == lcdCLK) {
         _hardware = true;
         /* The SPI hardware pins MOSI (SI), SCK (CLK) and SS (CSB) are defined for the
          * Arduino (Uno) in the library <pins_arduino.h> as pins 11, 13 & 10, respectively,
          * and are defined for the Particle Core in the library <spark_wiring.h> as pins 15,
-         * 13, & 12 (i.e. A5, A3 & A2), respectively. So, let's use them.
+         * 13, & 12 (i.e. A5, A3 & A2), respectively. So, let's use them. CSB is driven by
+         * the driver, not the SPI hardware, so any pin will do - several displays can share
+         * the bus with a CSB pin each (see do_DogLcdBus.h).
          */
         this->lcdSI = MOSI;     // Master Out Slave Input, this is sending the bits
         this->lcdCLK = SCK;     // Serial Clock, this is setting the timing of the bits
-        this->lcdCSB = SS;      // Slave Select, this is telling the device it's selected
+        this->lcdCSB = (lcdCSB>=0) ? lcdCSB : SS;  // Slave Select, this is telling the device it's selected
     } else {
         _hardware = false;
         this->lcdSI=lcdSI;
@@ -93,17 +88,45 @@ DogLcdhw::DogLcdhw(int lcdSI, int lcdCLK, int lcdCSB, int lcdRS, int lcdRESET, i
     this->lcdRS=lcdRS;          // Register Select, flags DOG controller to write data to internal RAM.
     this->lcdRESET=lcdRESET;    // Reset, this provides a hardware reset. Software reset is available.
     this->backLight=backLight;
+    _clockSpeed=spiClock;
+    _dataMode=spiMode;
+    _bitOrder=MSBFIRST;
+    DOG_STAT_COUNT(reset());
+#if defined(DOG_LCDhw_TRACE)
+    _traceTrack=DogLcdTrace::newTrack();
+#endif
 }
 
 int DogLcdhw::begin(int model, int vcc, int contrast, int gain) {
+    DOG_API_SCOPE(DOG_STAT_BEGIN);
+    if(configure(model,vcc,contrast,gain)!=0)
+        return -1;
+
+    // the reset() method does the actual display initialization
+    reset();
+
+    // success
+    return 0;
+}
+
+int DogLcdhw::beginAsync(int model, int vcc, int contrast, int gain, bool warmStart) {
+    DOG_API_SCOPE(DOG_STAT_BEGIN);
+    if(configure(model,vcc,contrast,gain)!=0)
+        return -1;
+    // poll() does the rest
+    startReset(warmStart);
+    return 0;
+}
+
+int DogLcdhw::configure(int model, int vcc, int contrast, int gain) {
 
     //init all pins to go HIGH, we dont want to send any commands by accident
-    pinMode(this->lcdCSB,OUTPUT);
-    digitalWrite(this->lcdCSB,HIGH);
-    pinMode(this->lcdSI,OUTPUT);
-    digitalWrite(this->lcdSI,HIGH);
-    pinMode(this->lcdCLK,OUTPUT);
-    digitalWrite(this->lcdCLK,HIGH);
+    dogPinMode(this->lcdCSB,OUTPUT);
+    dogDigitalWrite(this->lcdCSB,HIGH);
+    dogPinMode(this->lcdSI,OUTPUT);
+    dogDigitalWrite(this->lcdSI,HIGH);
+    dogPinMode(this->lcdCLK,OUTPUT);
+    dogDigitalWrite(this->lcdCLK,HIGH);
 
     // if hardware connections, configure SPI
     if (_hardware) {
@@ -137,106 +160,82 @@ int DogLcdhw::begin(int model, int vcc, int contrast, int gain) {
          *                 Mode0 set, fails with DIV2 and DIV4, works DIV8->DIV128
          * TESTED: SPARK   Mode3 set, fails with DIV16, works with DIV32 and DIV128
          *                 Mode0 set, fails with DIV16, works with DIV32 and DIV128
+         *
+         * These are the defaults of the constructor (DOG_LCDhw_SPI_CLOCK and mode 3). They
+         * are applied by select() every time the display takes the bus, see dogSpiBegin().
          */
         SPI.begin();
-        SPI.setBitOrder(MSBFIRST);
-        SPI.setDataMode(SPI_MODE3);
-        SPI.setClockDivider(theClockDivider);
     }
 
-    pinMode(this->lcdRS,OUTPUT);
-    digitalWrite(this->lcdRS,HIGH);
+    dogPinMode(this->lcdRS,OUTPUT);
+    dogDigitalWrite(this->lcdRS,HIGH);
+
+    // resolve the pins toggled for every byte once, so the transfers
+    // can use direct port writes
+    dogFastPinInit(_fastSI,this->lcdSI);
+    dogFastPinInit(_fastCLK,this->lcdCLK);
+    dogFastPinInit(_fastCSB,this->lcdCSB);
+    dogFastPinInit(_fastRS,this->lcdRS);
 
     if(this->lcdRESET!=-1) {
-        pinMode(this->lcdRESET,OUTPUT);
-        digitalWrite(this->lcdRESET,HIGH);
+        dogPinMode(this->lcdRESET,OUTPUT);
+        dogDigitalWrite(this->lcdRESET,HIGH);
     }
 
     if(this->backLight!=-1) {
-        pinMode(this->backLight,OUTPUT);
-        digitalWrite(this->backLight,LOW);
+        dogPinMode(this->backLight,OUTPUT);
+        dogDigitalWrite(this->backLight,LOW);
     }
 
-    // set all model-specific parameters here
+    // set all model-specific parameters here, the values for
+    // each model are in DogLcdModel (do_DogLcd.h)
     if(model==DOG_LCDhw_M081) {
-        this->model=model;
-        // model-dependent parameters
-        rows=1;
-        cols=8;
-        memSize=80;
-        startAddress[0]=0;
-        startAddress[1]=-1;
-        startAddress[2]=-1;
-        // dmf - new
-        biasAndFx = 0x14;
-        //8-bit,1-line
-        instructionSetTemplate=(uint8_t)0x30;
+        setModel<DogLcdModel<DOG_LCDhw_M081> >();
     }
     else if(model==DOG_LCDhw_M162) {
-        this->model=model;
-        // model-dependent parameters
-        rows=2;
-        cols=16;
-        memSize=40;
-        startAddress[0]=0;
-        startAddress[1]=0x40;
-        startAddress[2]=-1;
-        // dmf - new
-        biasAndFx = 0x14;
-        //8-bit,2-line
-        instructionSetTemplate=(uint8_t)0x38;
+        setModel<DogLcdModel<DOG_LCDhw_M162> >();
     }
     else if(model==DOG_LCDhw_M163) {
-        this->model=model;
-        // model-dependent parameters
-        rows=3;
-        cols=16;
-        memSize=16;
-        startAddress[0]=0;
-        startAddress[1]=0x10;
-        startAddress[2]=0x20;
-        // dmf - new
-        biasAndFx = 0x15;
-        //8-bit,3-line
-        instructionSetTemplate=(uint8_t)0x38;
+        setModel<DogLcdModel<DOG_LCDhw_M163> >();
     }
     else {
         //unknown or unsupported model
         return -1;
     }
+    this->model=model;
 
-    // and set all voltage-depedendent parameters here
+    // and set all voltage-depedendent parameters here (DogLcdSupply)
     if (vcc==DOG_LCDhw_VCC_5V) {
-        this->vcc=vcc;
-        // dmf - new
-        boosterMode = 0x00;
-        biasAndFx |= 0x08;
+        typedef DogLcdSupply<DOG_LCDhw_VCC_5V> Supply;
+        boosterMode = Supply::boosterMode;
+        biasAndFx |= Supply::bias;
         // set default contrast and gain (amplification ratio)
         if (contrast == -1){
             // set a default that seems to work for 5V
-            contrast = GOOD_5V_CONTRAST;
+            contrast = Supply::contrast;
         }
         if (gain == -1) {
             // set a default that seems to work for 5V
-            gain = GOOD_5V_GAIN;
+            gain = Supply::gain;
         }
     } else if (vcc==DOG_LCDhw_VCC_3V3) {
-        this->vcc=vcc;
-        // dmf - new
-        boosterMode = 0x04;
+        typedef DogLcdSupply<DOG_LCDhw_VCC_3V3> Supply;
+        boosterMode = Supply::boosterMode;
+        biasAndFx |= Supply::bias;
         // set default contrast and gain (amplification ratio)
         if (contrast == -1){
             // set a default that seems to work for 3V3
-            contrast = GOOD_3V3_CONTRAST;
+            contrast = Supply::contrast;
         }
         if (gain == -1) {
             // set a default that seems to work for 3V3
-            gain = GOOD_3V3_GAIN;
+            gain = Supply::gain;
         }
     } else {
         //unknown or unsupported supply voltage
         return -1;
     }
+    this->vcc=vcc;
 
     if(contrast < 0 || contrast> 0x3F) {
         //contrast is outside the valid range
@@ -244,30 +243,89 @@ int DogLcdhw::begin(int model, int vcc, int contrast, int gain) {
     }
     this->contrast=contrast;
     this->gain=gain;
-
-    // the reset() method does the actual display initialization
-    reset();
-
-    // success
     return 0;
 }
 
 /* runs (or re-runs) the controller initialization sequence */
 void DogLcdhw::reset() {
+    DOG_API_SCOPE(DOG_STAT_RESET);
+    startReset(false);
+    finishReset();
+}
+
+void DogLcdhw::startReset(bool warmStart) {
 
+    // whatever is still queued goes out before the reset
+    waitIdle();
+    waitDma();
+
+    if(warmStart) {
+        // the display kept its power (and settings), there is nothing
+        // to wait for
+        startInitWait(INIT_POWER_WAIT,0);
+        _cgramKnown=0;
+    }
     // a hardware reset will delete any createChars() so protect created
     // characters by testing before allowing a hard reset
-    if(lcdRESET!=-1 && _noCharsAdded) {
-        //If user wired the reset line, pull it low and wait for 40 millis
-        digitalWrite(lcdRESET,LOW);
-        delay(40);
-        digitalWrite(lcdRESET,HIGH);
-        delay(40);
+    else if(lcdRESET!=-1 && _noCharsAdded) {
+        //If user wired the reset line, pull it low for 40 millis, then
+        //give the controller another 40 millis (see stepReset())
+        dogDigitalWrite(lcdRESET,LOW);
+        startInitWait(INIT_RESET_LOW,40000UL);
+        _cgramKnown=0;
     }
     else {
         //User wants software reset, we simply wait a bit for stable power
-        delay(50);
+        startInitWait(INIT_POWER_WAIT,50000UL);
     }
+    stepReset();
+}
+
+void DogLcdhw::finishReset() {
+    while(_initState!=INIT_READY) {
+        unsigned long elapsed=dogMicros()-_initSince;
+        if(elapsed<_initFor) {
+            unsigned long remaining=_initFor-elapsed;
+            dogDelay(remaining/1000);
+            dogDelayMicroseconds(remaining%1000);
+            DOG_STAT_COUNT(countBlocking(remaining));
+        }
+        stepReset();
+    }
+}
+
+bool DogLcdhw::isReady() {
+    stepReset();
+    return _initState==INIT_READY;
+}
+
+void DogLcdhw::startInitWait(uint8_t state, unsigned long us) {
+    _initState=state;
+    _initSince=dogMicros();
+    _initFor=us;
+}
+
+void DogLcdhw::stepReset() {
+    if(_initState==INIT_READY || _initState==INIT_SENDING)
+        return;
+    if(dogMicros()-_initSince<_initFor)
+        return;
+    if(_initState==INIT_RESET_LOW) {
+        dogDigitalWrite(lcdRESET,HIGH);
+        startInitWait(INIT_RESET_HIGH,40000UL);
+        return;
+    }
+    // done waiting, now talk to the controller
+    _initState=INIT_SENDING;
+    sendInit();
+    _initState=INIT_READY;
+}
+
+void DogLcdhw::sendInit() {
+
+    // whatever state the controller had is gone (or unknown), so the
+    // whole initialization sequence has to be sent
+    forgetState();
 
     /* initialization sequence */
     // set Bias and Fx
@@ -286,73 +344,99 @@ void DogLcdhw::reset() {
     entryMode=0x04;
     leftToRight();
 
-    // finally, clear the display
-    clear();
+    // finally, clear the display (and with it the shadow)
+    writeClear();
 
 }
 
 void DogLcdhw::setInstructionSet(uint8_t is) {
-    if(is<0 || is>3)
+    if(is>3 || is==_sentTable)
         return;
     uint8_t cmd=instructionSetTemplate | is;
-    writeCommand(cmd,30);
+    writeCommand(cmd);
+    _sentTable=is;
+}
+
+void DogLcdhw::writeState(uint8_t cmd, uint8_t &sent, uint8_t is) {
+    if(cmd==sent)
+        return;
+    setInstructionSet(is);
+    writeCommand(cmd);
+    sent=cmd;
+}
+
+void DogLcdhw::forgetState() {
+    // none of the commands cached here is ever 0xFF
+    _sentTable=0xFF;
+    _sentBias=0xFF;
+    _sentPower=0xFF;
+    _sentContrast=0xFF;
+    _sentFollower=0xFF;
+    _sentDisplay=0xFF;
+    _sentEntry=0xFF;
+    _address=-1;
+    _shift=-1;
 }
 
 /* the following commands are all accessible through Instruction Table 1 */
 void DogLcdhw::setBiasAndFx() {
-    // contrast is in instruction Table 1
-    setInstructionSet(1);
-    //bias and Fx are model- and voltage- specific
-    writeCommand(biasAndFx,30);
+    //bias and Fx are model- and voltage- specific, and in instruction Table 1
+    writeState(biasAndFx,_sentBias,1);
 }
 
 /* set the contrast - contrast and gain (amplification ratio) are highly correlated */
 void DogLcdhw::setContrast(int contrast) {
+    DOG_API_SCOPE(DOG_STAT_CONTRAST);
     if(contrast<0 || contrast>0x3F)
 	return;
-    // contrast is in instruction Table 1
-    setInstructionSet(1);
-
     // contrast is determined by 6 bits, written as part of two
     // commands, 0x50 and 0x70, under Instruction Table 1.
     // boosterMode (off for 5V, on for 3V3) is written during the
-    // same command as the (2-bit) high-nibble of contrast
-    writeCommand(0x50 | boosterMode | ((contrast>>4)&0x03), 30);
+    // same command as the (2-bit) high-nibble of contrast.
+    // Either command is only sent if it changes something.
+    writeState(0x50 | boosterMode | ((contrast>>4)&0x03),_sentPower,1);
     // now set the low-nibble of the contrast
-    writeCommand((0x70 | (contrast & 0x0F)),30);
+    writeState(0x70 | (contrast & 0x0F),_sentContrast,1);
 
 }
 
 /* set the amplification ratio (gain) - gain and contrast are highly correlated */
 void DogLcdhw::setGain(int gain) {
+    DOG_API_SCOPE(DOG_STAT_CONTRAST);
     if (gain<0 || gain>0x07)
         return;
     // Gain is in instruction Table 1
-    setInstructionSet(1);
     // The command selector is 0x60, follower control is set with
     // 0x08, and gain is determined by the three bits, 0x00->0x07
-    writeCommand(0x60 | 0x08 | gain,30);
+    writeState(0x60 | 0x08 | gain,_sentFollower,1);
 
 }
 
 /* the following commands are all accessible through Instruction Table 0 */
 void DogLcdhw::scrollDisplayLeft(void) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
+    sendHome();
     setInstructionSet(0);
-    writeCommand(0x18,30);
+    writeCommand(0x18);
+    if(_shift>=0)
+        _shift=(_shift+1)%memSize;
 }
 
 void DogLcdhw::scrollDisplayRight(void) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
+    sendHome();
     setInstructionSet(0);
-    writeCommand(0x1C,30);
+    writeCommand(0x1C);
+    if(_shift>=0)
+        _shift=(_shift+memSize-1)%memSize;
 }
 
 /* Eight character addresses at the start of the CGRAM
  * character matrix are empty and meant to be available to
  * create custom characters as needed.
  */
-void DogLcdhw::createChar(int charPos, uint8_t charMap[]) {
-
-    int baseAddress;
+void DogLcdhw::createChar(int charPos, const uint8_t charMap[]) {
+    DOG_API_SCOPE(DOG_STAT_CREATE_CHAR);
 
     /* charPos selects which of the 8 addresses available
      * to use at the start of the CGRAM table is selected.
@@ -360,119 +444,608 @@ void DogLcdhw::createChar(int charPos, uint8_t charMap[]) {
     if(charPos<0 || charPos>7)
         return;
 
-    //changing CGRAM address belongs to instruction Table 0
-    setInstructionSet(0);
+    writeGlyphs(charPos,1,(const uint8_t (*)[8])charMap);
 
-    /* Tell the controller the CGRAM address to write to.
-     * The 0x40 command in Table 0 is the instruction for setting
-     * the CGRAM address. Note the CGRAM address will autoincrement
-     * as we write to it.
+    /* The cursor goes back to the start of the first line. Setting
+     * the DDRAM address also tells the controller that future data
+     * writes are to the display DDRAM, not CGRAM, but that is left to
+     * the next drawing call - the address counter is still in CGRAM,
+     * so it sends the DDRAM address first, and a setCursor() that
+     * follows right away costs nothing extra.
      */
-    baseAddress=charPos*8;
-    writeCommand((0x40|(baseAddress)),30);
+    _framePos=0;
+}
 
-    /* We are now writing the bits of the character matrix
-     * Important - because of the previous CGRAM address command
-     * the controller knows to write these bits to CGRAM, not DDRAM
-     */
-    for (int i=0; i<8; i++) {
-        writeChar(charMap[i]);
-    }
+void DogLcdhw::loadGlyphs(int firstSlot, int count, const uint8_t (*maps)[8]) {
+    DOG_API_SCOPE(DOG_STAT_CREATE_CHAR);
+    if(firstSlot<0 || count<1 || firstSlot+count>8)
+        return;
+    int restore=_address;
+    writeGlyphs(firstSlot,count,maps);
+    // drawing calls set the DDRAM address again by themselves, only a
+    // visible cursor has to be put back right away
+    if(restore>=0 && _address<0 && (cursorMode || blinkMode))
+        writeAddress(restore);
+}
 
-    /* The following simply sets the cursor position, but that's
-     * done by setting the DDRAM address, so it also serves to tell
-     * the controller that future data writes are to the display DDRAM,
-     * not CGRAM. The 0x80 command used in setCursor is in the default
-     * instruction Table, so no setInstructionSet required.
-     */
-    setCursor(0,0);
+void DogLcdhw::writeGlyphs(int firstSlot, int count, const uint8_t (*maps)[8]) {
+    // the CGRAM address follows the entry mode, so one that a buffered
+    // clear() left for flush() has to go out first
+    writeState(entryMode,_sentEntry,ANY_TABLE);
+    bool forward=entryMode & 0x02;
+    int base=firstSlot*8;
+    int len=count*8;
+    uint8_t burst[64];
+    int i=0;
+    while(i<len) {
+        // leave alone the rows the CGRAM already holds
+        if(!cgramDiffers(base+i,maps[i/8][i%8])) {
+            i++;
+            continue;
+        }
+        /* A run of rows to rewrite. Sending one unchanged row costs no
+         * more than a new CGRAM address, so a run goes on across such
+         * single row gaps.
+         */
+        int end=i+1;
+        while(end<len) {
+            if(cgramDiffers(base+end,maps[end/8][end%8]))
+                end++;
+            else if(end+1<len && cgramDiffers(base+end+1,maps[(end+1)/8][(end+1)%8]))
+                end+=2;
+            else
+                break;
+        }
+
+        /* One CGRAM address command and one burst for the run, the
+         * CGRAM address autoincrements as we write to it. The address
+         * counter follows the entry mode, so right-to-left the run is
+         * sent backwards from its last byte.
+         */
+        int n=end-i;
+        for(int k=0; k<n; k++) {
+            int row=forward ? i+k : end-1-k;
+            burst[k]=maps[row/8][row%8] & 0x1F;
+        }
+        //changing CGRAM address belongs to instruction Table 0
+        setInstructionSet(0);
+        writeCommand(0x40|(forward ? base+i : base+end-1));
+        _address=-1;
+        writeData(burst,n);
+        for(int row=i; row<end; row++) {
+            _cgram[base+row]=maps[row/8][row%8] & 0x1F;
+            // a slot that was unknown differed in every row, so it is complete now
+            _cgramKnown|=1<<((base+row)/8);
+        }
+        i=end;
+    }
 
     /* set flag to prevent hard reset (which will delete our new chars)
      */
     _noCharsAdded = false;
+}
 
+bool DogLcdhw::cgramDiffers(int index, uint8_t row) {
+    if(!(_cgramKnown & (1<<(index/8))))
+        return true;
+    return _cgram[index]!=(row & 0x1F);
 }
 
 /* the following commands are all accessible through the default Instruction Table */
 void DogLcdhw::clear() {
-    writeCommand(0x01,1080);
+    DOG_API_SCOPE(DOG_STAT_CLEAR);
+    if(_drawPage>=0) {
+        // the clear command would blank the other pages as well, so
+        // only the cells of this page are blanked and sent
+        int origin=pageOrigin();
+        for(int row=0; row<rows; row++) {
+            for(int col=origin; col<origin+cols; col++)
+                setFrame(row*memSize+col,' ');
+        }
+        _framePos=origin;
+        if(!_buffered) {
+            flush();
+            writeAddress(_framePos);
+        }
+        return;
+    }
+    if(_buffered) {
+        /* only blank the frame, flush() sends what actually changed.
+         * The controller's clear also takes back the display shift and
+         * sets left-to-right entry, so those are changed here the same
+         * way and go out with the next flush() (or a clear, if cheaper).
+         */
+        for(int i=0; i<rows*memSize; i++)
+            setFrame(i,' ');
+        _framePos=0;
+        entryMode|=0x02;
+        if(_shift!=0)
+            _homePending=true;
+        return;
+    }
+    writeClear();
+}
+
+void DogLcdhw::writeClear() {
+    sendClear();
+    clearShadow();
+}
+
+void DogLcdhw::sendClear() {
+    writeCommand(0x01);
+    _address=0;
+    _shift=0;
+    _homePending=false;
+    // clearing also sets the controller back to left-to-right entry
+    entryMode|=0x02;
+    if(_sentEntry!=0xFF)
+        _sentEntry|=0x02;
+}
+
+void DogLcdhw::sendHome() {
+    // the shift moves on from where a buffered clear() or home() left it
+    if(!_homePending)
+        return;
+    _homePending=false;
+    if(_shift!=0) {
+        writeCommand(0x02);
+        _address=0;
+        _shift=0;
+    }
 }
 
 void DogLcdhw::home() {
-    writeCommand(0x02,1080);
+    DOG_API_SCOPE(DOG_STAT_HOME);
+    _framePos=pageOrigin();
+    if(_drawPage>=0) {
+        // the start of the page, the display stays on the page it shows
+        if(!_buffered)
+            writeAddress(_framePos);
+        return;
+    }
+    if(_buffered) {
+        // the display shift is taken back with the next flush()
+        if(_shift!=0)
+            _homePending=true;
+        return;
+    }
+    if(_shift!=0) {
+        writeCommand(0x02);
+        _address=0;
+        _shift=0;
+    } else {
+        // without a display shift to take back, a cursor jump does
+        // the same in a fraction of the time
+        writeAddress(0);
+    }
 }
 
 void DogLcdhw::setCursor(int col, int row) {
+    DOG_API_SCOPE(DOG_STAT_SET_CURSOR);
+    if(col<0 || row<0)
+        return;
+    col+=pageOrigin();
     if(col>=memSize || row>=rows) {
 	//not a valid cursor position
 	return;
     }
-    int address=(startAddress[row]+col) & 0x7F;
-    writeCommand(0x80|address,30);
+    _framePos=row*memSize+col;
+    if(!_buffered)
+        writeAddress(_framePos);
+}
+
+void DogLcdhw::setBuffered(bool buffered) {
+    if(_buffered && !buffered) {
+        // catch the display up, then put the controller's address
+        // counter where the next character is to be drawn
+        flush();
+        writeAddress(_framePos);
+    }
+    _buffered=buffered;
+}
+
+void DogLcdhw::getCursor(int &col, int &row) {
+    col=_framePos%memSize-pageOrigin();
+    row=_framePos/memSize;
+}
+
+bool DogLcdhw::setDrawPage(int page) {
+    if(page<-1 || page>=getPageCount())
+        return false;
+    _drawPage=page;
+    _framePos=pageOrigin();
+    if(!_buffered)
+        writeAddress(_framePos);
+    return true;
+}
+
+bool DogLcdhw::showPage(int page) {
+    DOG_API_SCOPE(DOG_STAT_PAGE);
+    if(page<0 || page>=getPageCount())
+        return false;
+    if(_buffered)
+        flush();
+    int target=page*cols;
+    /* The shift goes around the line, so the page can be reached either
+     * way. Returning home costs as much as 36 shifts but starts from a
+     * known shift, which is the only way when the shift is unknown.
+     */
+    int left=(_shift<0) ? 0 : (target-_shift+memSize)%memSize;
+    int right=(memSize-left)%memSize;
+    bool toLeft=left<=right;
+    int cells=toLeft ? left : right;
+    if(_shift<0 || (unsigned long)_clearHomeMicros+(unsigned long)target*_shortMicros<(unsigned long)cells*_shortMicros) {
+        writeCommand(0x02);
+        _address=0;
+        _shift=0;
+        toLeft=true;
+        cells=target;
+    }
+    shiftDisplay(cells,toLeft);
+    return true;
+}
+
+int DogLcdhw::getShownPage() {
+    if(_shift<0 || _shift%cols!=0 || _shift/cols>=getPageCount())
+        return -1;
+    return _shift/cols;
+}
+
+void DogLcdhw::flip() {
+    DOG_API_SCOPE(DOG_STAT_PAGE);
+    if(_drawPage<0)
+        return;
+    int shown=getShownPage();
+    int draw=_drawPage;
+    showPage(draw);
+    if(shown<0 || shown==draw)
+        shown=(draw+1)%getPageCount();
+    setDrawPage(shown);
+}
+
+void DogLcdhw::shiftDisplay(int cells, bool left) {
+    if(cells<=0)
+        return;
+    //display shift belongs to instruction Table 0
+    setInstructionSet(0);
+    uint8_t burst[16];
+    memset(burst,left ? 0x18 : 0x1C,sizeof(burst));
+    for(int n=cells; n>0; n-=sizeof(burst))
+        spiBurst(burst,n<(int)sizeof(burst) ? n : sizeof(burst),LOW,_shortMicros);
+    _shift=(_shift+(left ? cells : memSize-cells))%memSize;
+}
+
+void DogLcdhw::putChar(int col, int row, uint8_t value) {
+    DOG_API_SCOPE(DOG_STAT_WRITE);
+    if(col<0 || col>=memSize || row<0 || row>=rows)
+        return;
+    int index=row*memSize+col;
+    setFrame(index,value);
+    if(_buffered)
+        return;
+    if(_shown[index]!=value) {
+        writeAddress(index);
+        writeChar(value);
+        _shown[index]=value;
+    }
+    // drawing calls set the address again by themselves, only a
+    // visible cursor has to be put back right away
+    if(cursorMode || blinkMode)
+        writeAddress(_framePos);
+}
+
+int DogLcdhw::flush() {
+    DOG_API_SCOPE(DOG_STAT_FLUSH);
+    int sent=0;
+    planFlush(clearPays(),&sent);
+    return sent;
+}
+
+int DogLcdhw::flush(uint32_t maxMicros) {
+    DOG_API_SCOPE(DOG_STAT_FLUSH);
+    int cells=rows*memSize;
+    // cells waiting for 255 rounds stay that old
+    for(int i=0; i<cells; i++) {
+        if(_frame[i]!=_shown[i] && (uint8_t)(_flushRound-_dirtySince[i])==255)
+            _dirtySince[i]++;
+    }
+    _flushRound++;
+    /* Take the dirty cells a class of equal urgency at a time, most
+     * urgent first, for as long as the plan for all cells taken so far
+     * fits into the budget. The class that doesn't fit as a whole is
+     * taken one cell at a time, in the order the cells are sent, and
+     * less urgent cells wait even if some of them would still fit.
+     */
+    uint8_t only[(DOG_LCDhw_DDRAM_SIZE+7)/8];
+    memset(only,0,sizeof(only));
+    // the return home a buffered clear() or home() left waits for a
+    // budget it fits into, the cells don't need it; the entry mode
+    // they do need, so without room for it nothing is sent
+    bool home=planFlush(false,NULL,only)<=maxMicros;
+    if(planFlush(false,NULL,only,home)>maxMicros)
+        return 0;
+    long below=0x10000L;
+    while(true) {
+        long next=-1;
+        for(int i=0; i<cells; i++) {
+            if(_frame[i]!=_shown[i] && urgency(i)<below && urgency(i)>next)
+                next=urgency(i);
+        }
+        if(next<0)
+            break;
+        below=next;
+        for(int i=0; i<cells; i++) {
+            if(_frame[i]!=_shown[i] && urgency(i)==next)
+                only[i/8]|=1<<(i%8);
+        }
+        if(planFlush(false,NULL,only,home)<=maxMicros)
+            continue;
+        for(int i=0; i<cells; i++) {
+            if(_frame[i]!=_shown[i] && urgency(i)==next)
+                only[i/8]&=~(1<<(i%8));
+        }
+        for(int n=0; n<cells; n++) {
+            int i=(entryMode & 0x02) ? n : cells-1-n;
+            if(_frame[i]==_shown[i] || urgency(i)!=next)
+                continue;
+            only[i/8]|=1<<(i%8);
+            if(planFlush(false,NULL,only,home)>maxMicros) {
+                only[i/8]&=~(1<<(i%8));
+                break;
+            }
+        }
+        break;
+    }
+    int sent=0;
+    planFlush(false,&sent,only,home);
+    return sent;
+}
+
+void DogLcdhw::setPriority(int col, int row, int len, uint8_t priority) {
+    col+=pageOrigin();
+    if(col<0 || row<0 || row>=rows)
+        return;
+    for(int i=0; i<len && col+i<memSize; i++)
+        _priority[row*memSize+col+i]=priority;
+}
+
+uint16_t DogLcdhw::urgency(int index) {
+    return (_priority[index]<<8) | (uint8_t)(_flushRound-_dirtySince[index]);
+}
+
+void DogLcdhw::setFrame(int index, uint8_t value) {
+    if(_frame[index]==_shown[index])
+        _dirtySince[index]=_flushRound;
+    _frame[index]=value;
+}
+
+unsigned long DogLcdhw::estimateMicros() {
+    return planFlush(clearPays(),NULL);
+}
+
+bool DogLcdhw::clearPays() {
+    // clear also takes back a display shift and sets the entry mode to
+    // left-to-right, so it is only an option when neither makes a
+    // difference or a buffered clear() asked for both anyway
+    if((_shift!=0 && !_homePending) || !(entryMode & 0x02))
+        return false;
+    // it would blank the visible page while another one is drawn
+    if(_drawPage>=0)
+        return false;
+    return planFlush(true,NULL)<planFlush(false,NULL);
+}
+
+unsigned long DogLcdhw::planFlush(bool fromClear, int *sent, const uint8_t *only, bool home) {
+    int cells=rows*memSize;
+    bool forward=entryMode & 0x02;
+    int step=forward ? 1 : -1;
+    unsigned long micros=0;
+    // the shadow index the controller's address counter will point at
+    // once the pending run is sent, -1 if unknown
+    int next=_address;
+    if(fromClear) {
+        micros+=_clearHomeMicros;
+        next=0;
+        if(sent!=NULL) {
+            sendClear();
+            for(int i=0; i<cells; i++)
+                _shown[i]=' ';
+        }
+    } else {
+        // what a buffered clear() or home() left for later: the return
+        // home and the entry mode
+        if(home && _homePending && _shift!=0) {
+            micros+=_clearHomeMicros;
+            next=0;
+        }
+        if(entryMode!=_sentEntry)
+            micros+=_shortMicros;
+        if(sent!=NULL) {
+            if(home)
+                sendHome();
+            writeState(entryMode,_sentEntry,ANY_TABLE);
+        }
+    }
+    // changed cells that follow each other are collected, in the order
+    // they are sent, and go out as one burst
+    uint8_t run[16];
+    size_t runLen=0;
+    // walk the cells in entry direction so the controller's address
+    // increment (or decrement) covers runs of changed cells for free
+    for(int n=0; n<cells; n++) {
+        int i=forward ? n : cells-1-n;
+        uint8_t shown=fromClear ? ' ' : _shown[i];
+        if(_frame[i]==shown)
+            continue;
+        if(only!=NULL && !(only[i/8] & (1<<(i%8))))
+            continue;
+        int from=i;
+        if(i!=next) {
+            // the unchanged cells between the address counter and this one
+            int gap=(next<0) ? -1 : (i-next)*step;
+            if(gap==1) {
+                // sending the cell again is no dearer than a cursor jump
+                from=next;
+            } else {
+                micros+=_shortMicros;
+                if(sent!=NULL) {
+                    writeData(run,runLen);
+                    runLen=0;
+                    writeAddress(i);
+                }
+            }
+        }
+        for(int k=from; ; k+=step) {
+            micros+=_shortMicros;
+            if(sent!=NULL) {
+                if(runLen==sizeof(run)) {
+                    writeData(run,runLen);
+                    runLen=0;
+                }
+                run[runLen++]=_frame[k];
+                _shown[k]=_frame[k];
+                (*sent)++;
+            }
+            if(k==i)
+                break;
+        }
+        // the hardware wrap-around differs between models, so don't rely on it
+        next=i+step;
+        if(next<0 || next>=cells)
+            next=-1;
+    }
+    if(sent!=NULL)
+        writeData(run,runLen);
+    return micros;
+}
+
+void DogLcdhw::invalidate() {
+    // the complement always differs, so every cell ends up being resent
+    for(int i=0; i<rows*memSize; i++) {
+        if(_frame[i]==_shown[i])
+            _dirtySince[i]=_flushRound;
+        _shown[i]=(uint8_t)~_frame[i];
+    }
+}
+
+int DogLcdhw::countChar(uint8_t c) {
+    int count=0;
+    for(int i=0; i<rows*memSize; i++) {
+        if(_frame[i]==c || _shown[i]==c)
+            count++;
+    }
+    return count;
+}
+
+void DogLcdhw::writeAddress(int index) {
+    if(index==_address)
+        return;
+    int address=(startAddress[index/memSize]+index%memSize) & 0x7F;
+    writeCommand(0x80|address);
+    _address=index;
+}
+
+void DogLcdhw::advanceAddress(size_t len) {
+    // with autoscroll on, every character moves the display
+    if(entryMode & 0x01)
+        _shift=-1;
+    if(_address<0)
+        return;
+    int cells=rows*memSize;
+    int step=(entryMode & 0x02) ? 1 : -1;
+    _address+=step*(int)len;
+    // the hardware wrap-around differs between models, so don't rely on it
+    if(_address<0 || _address>=cells)
+        _address=-1;
+}
+
+int DogLcdhw::nextIndex(int index) {
+    int cells=rows*memSize;
+    if(entryMode & 0x02)
+        return (index+1<cells) ? index+1 : 0;
+    return (index>0) ? index-1 : cells-1;
+}
+
+void DogLcdhw::clearShadow() {
+    for(int i=0; i<DOG_LCDhw_DDRAM_SIZE; i++) {
+        _frame[i]=' ';
+        _shown[i]=' ';
+    }
+    _framePos=0;
 }
 
 void DogLcdhw::noDisplay() {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     displayMode=0x00;
     writeDisplayMode();
 }
 
 void DogLcdhw::display() {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     displayMode=0x04;
     writeDisplayMode();
 }
 
 void DogLcdhw::noCursor() {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     cursorMode=0x00;
     writeDisplayMode();
 }
 
 void DogLcdhw::cursor() {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     cursorMode=0x02;
     writeDisplayMode();
 }
 
 void DogLcdhw::noBlink() {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     blinkMode=0x00;
     writeDisplayMode();
 }
 
 void DogLcdhw::blink() {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     blinkMode=0x01;
     writeDisplayMode();
 }
 
 void DogLcdhw::writeDisplayMode() {
-    writeCommand((0x08 | displayMode | cursorMode | blinkMode),30);
+    writeState((0x08 | displayMode | cursorMode | blinkMode),_sentDisplay,ANY_TABLE);
 }
 
 void DogLcdhw::leftToRight(void) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     entryMode|=0x02;
-    writeCommand(entryMode,30);
+    writeState(entryMode,_sentEntry,ANY_TABLE);
 }
 
 void DogLcdhw::rightToLeft(void) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     entryMode&=~0x02;
-    writeCommand(entryMode,30);
+    writeState(entryMode,_sentEntry,ANY_TABLE);
 }
 
 void DogLcdhw::autoscroll(void) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     entryMode|=0x01;
-    writeCommand(entryMode,30);
+    writeState(entryMode,_sentEntry,ANY_TABLE);
 }
 
 void DogLcdhw::noAutoscroll(void) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
     entryMode&=~0x01;
-    writeCommand(entryMode,30);
+    writeState(entryMode,_sentEntry,ANY_TABLE);
 }
 
 void DogLcdhw::setBacklight(int value, bool usePWM) {
     if(backLight!=-1 && value>=0) {
 	if(!usePWM) {
 	    if(value==LOW) {
-		digitalWrite(backLight,LOW);
+		dogDigitalWrite(backLight,LOW);
 	    }
 	    else {
-		digitalWrite(backLight,HIGH);
+		dogDigitalWrite(backLight,HIGH);
 	    }
 	}
 	else {
@@ -484,49 +1057,432 @@ void DogLcdhw::setBacklight(int value, bool usePWM) {
 }
 
 void DogLcdhw::ascii (char character) {
-    writeChar(character);
+    DOG_API_SCOPE(DOG_STAT_WRITE);
+    drawChar(character);
+}
+
+void DogLcdhw::drawChar(uint8_t value) {
+    setFrame(_framePos,value);
+    if(!_buffered) {
+        writeAddress(_framePos);
+        writeChar(value);
+        _shown[_framePos]=value;
+    }
+    _framePos=nextIndex(_framePos);
+}
+
+void DogLcdhw::drawChars(const uint8_t *chars, size_t len) {
+    if(_buffered) {
+        for(size_t i=0; i<len; i++)
+            drawChar(chars[i]);
+        return;
+    }
+    int cells=rows*memSize;
+    while(len>0) {
+        // split the burst where the shadow wraps around, the
+        // controller's address counter wraps differently
+        size_t n=(entryMode & 0x02) ? cells-_framePos : _framePos+1;
+        if(n>len)
+            n=len;
+        writeAddress(_framePos);
+        for(size_t i=0; i<n; i++) {
+            _frame[_framePos]=chars[i];
+            _shown[_framePos]=chars[i];
+            _framePos=nextIndex(_framePos);
+        }
+        writeData(chars,n);
+        chars+=n;
+        len-=n;
+    }
+}
+
+void DogLcdhw::writeData(const uint8_t *data, size_t len) {
+    spiBurst(data,len,HIGH,_shortMicros);
+    advanceAddress(len);
+}
+
+void DogLcdhw::writeCommands(const uint8_t *cmds, size_t len) {
+    spiBurst(cmds,len,LOW,_shortMicros);
+    // these could have changed anything
+    forgetState();
 }
 
 void DogLcdhw::writeChar(uint8_t value) {
+    DOG_TRACE_SCOPE_BYTE("writeChar",value);
     /* Setting RS HIGH tells the controller we're
      * sending data, not a sending a command. Data
      * is written to the register address (CGRAM, or DDRAM)
      * that was last set
      */
-    digitalWrite(lcdRS,HIGH);
-    spiTransfer(value,30);
+    spiTransfer(value,HIGH,_shortMicros);
+    advanceAddress(1);
 }
 
-void DogLcdhw::writeCommand(uint8_t value,int executionTime) {
+void DogLcdhw::writeCommand(uint8_t value) {
+    DOG_TRACE_SCOPE_BYTE("writeCommand",value);
     /* Setting RS LOW tells the controller we're sending
      * a command, not writing data
      */
-    digitalWrite(lcdRS,LOW);
-    spiTransfer(value,executionTime);
+    spiTransfer(value,LOW,executionMicros(value));
+}
+
+int DogLcdhw::executionMicros(uint8_t cmd) {
+    return dogInstructionClocks(cmd)==DOG_LCDhw_CLOCKS_CLEAR_HOME ? _clearHomeMicros : _shortMicros;
+}
+
+bool DogLcdhw::setTiming(uint32_t fosc, uint8_t margin) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
+    // the times are kept in 16 bits, the longest has to fit
+    if(fosc<DOG_LCDhw_FOSC_MIN(margin))
+        return false;
+    _shortMicros=dogExecutionMicros(DOG_LCDhw_CLOCKS_SHORT,fosc,margin);
+    _clearHomeMicros=dogExecutionMicros(DOG_LCDhw_CLOCKS_CLEAR_HOME,fosc,margin);
+    return true;
+}
+
+void DogLcdhw::spiTransfer(uint8_t value, int rs, int executionTime) {
+    DOG_TRACE_SCOPE_BYTE("spiTransfer",value);
+    if(_initState!=INIT_READY && _initState!=INIT_SENDING)
+        finishReset();
+    if(_async) {
+        DOG_STAT_COUNT(countByte(value,rs));
+        enqueue(value,rs,executionTime);
+        return;
+    }
+    if(_capture!=NULL && capture(value,rs,executionTime))
+        return;
+    DOG_STAT_COUNT(countByte(value,rs));
+    waitDma();
+    setRS(rs);
+    waitReady();
+    select();
+    spiShift(value);
+    deselect();
+    DOG_STAT_COUNT(countCsbEdges(2));
+    setBusy(executionTime);
+}
+
+inline void DogLcdhw::setRS(int rs) {
+    if(rs==HIGH)
+        dogFastPinHigh(_fastRS);
+    else
+        dogFastPinLow(_fastRS);
+}
+
+inline void DogLcdhw::select() {
+    if(_hardware)
+        dogSpiBegin(_clockSpeed,_dataMode,_bitOrder);
+    dogFastPinLow(_fastCSB);
+}
+
+inline void DogLcdhw::deselect() {
+    dogFastPinHigh(_fastCSB);
+    if(_hardware)
+        dogSpiEnd();
+}
+
+void DogLcdhw::spiBurst(const uint8_t *values, size_t len, int rs, int executionTime) {
+    DOG_TRACE_SCOPE("spiBurst");
+    if(_initState!=INIT_READY && _initState!=INIT_SENDING)
+        finishReset();
+    if(_async) {
+        for(size_t i=0; i<len; i++) {
+            DOG_STAT_COUNT(countByte(values[i],rs));
+            enqueue(values[i],rs,executionTime);
+        }
+        return;
+    }
+    if(_capture!=NULL) {
+        // what isn't taken by the group goes out below
+        while(len>0 && capture(values[0],rs,executionTime)) {
+            values++;
+            len--;
+        }
+    }
+    if(len==0)
+        return;
+    waitDma();
+#if defined(DOG_LCDhw_DMA)
+    if(_pacedDma && len>=DOG_LCDhw_DMA_MIN && pacedClock(executionTime)!=0) {
+        dmaBurst(values,len,rs,executionTime);
+        return;
+    }
+#endif
+    // RS is sampled with the last bit of each byte, so it can stay put,
+    // and the ST7036 keeps accepting bytes for as long as CSB is LOW
+    setRS(rs);
+    waitReady();
+    select();
+    for(size_t i=0; i<len; i++) {
+        if(i>0)
+            waitReady();
+        DOG_STAT_COUNT(countByte(values[i],rs));
+        spiShift(values[i]);
+        setBusy(executionTime);
+    }
+    deselect();
+    DOG_STAT_COUNT(countCsbEdges(2));
+}
+
+bool DogLcdhw::capture(uint8_t value, int rs, int executionTime) {
+    DogLcdCapture &c=*_capture;
+    if(c.alone)
+        return false;
+    DogLcdCaptureBuffer &b=*c.buffer;
+    uint16_t entry=(rs==HIGH ? 0x8000 : 0) | (executionTime & 0x7FFF);
+    if(c.leader) {
+        if(b.length<b.size) {
+            b.data[b.length]=value;
+            b.entry[b.length]=entry;
+            b.length++;
+            return true;
+        }
+        // too much to share, what has been collected goes out first
+        c.alone=true;
+        sendCaptured(b.length);
+        return false;
+    }
+    if(c.matched<b.length && b.data[c.matched]==value && b.entry[c.matched]==entry) {
+        c.matched++;
+        return true;
+    }
+    // this display sends something else, so it goes its own way from
+    // here on, starting with what it had in common with the leader
+    c.alone=true;
+    sendCaptured(c.matched);
+    return false;
+}
+
+void DogLcdhw::sendCaptured(uint8_t count) {
+    DogLcdCapture *c=_capture;
+    _capture=NULL;
+    for(uint8_t i=0; i<count; i++) {
+        uint16_t entry=c->buffer->entry[i];
+        spiTransfer(c->buffer->data[i],(entry & 0x8000) ? HIGH : LOW,entry & 0x7FFF);
+    }
+    _capture=c;
+}
+
+void DogLcdhw::setBusy(int executionTime) {
+    _busySince=dogMicros();
+    _busyFor=executionTime;
+}
+
+void DogLcdhw::waitReady() {
+    // unsigned arithmetic keeps this right when micros() wraps around
+    unsigned long elapsed=dogMicros()-_busySince;
+    if(elapsed<_busyFor) {
+        dogDelayMicroseconds(_busyFor-elapsed);
+        DOG_STAT_COUNT(countBlocking(_busyFor-elapsed));
+    }
+    _busyFor=0;
+}
+
+bool DogLcdhw::controllerReady() {
+    return dogMicros()-_busySince>=_busyFor;
+}
+
+void DogLcdhw::setAsync(bool async) {
+    if(!async)
+        waitIdle();
+    _async=async;
+}
+
+int DogLcdhw::queueDepth() {
+    dogIrqState state=dogEnterCritical();
+    int depth=(uint8_t)(_queueHead-_queueTail);
+    dogExitCritical(state);
+    return depth;
+}
+
+void DogLcdhw::poll() {
+    DOG_API_SCOPE(DOG_STAT_POLL);
+    stepReset();
+    // a burst still going out has the bus
+    if(!finishDma())
+        return;
+    // normally only one byte goes out per call, the controller is busy
+    // for longer than a transfer takes
+    while(true) {
+        /* Only taking the byte off the queue is done with interrupts
+         * blocked. The transfer itself runs outside, since taking the
+         * bus may wait for a lock (SPI transactions on Particle).
+         * _polling keeps a poll() from an interrupt handler out while
+         * the byte is on its way.
+         */
+        dogIrqState state=dogEnterCritical();
+        if(_polling || _queueTail==_queueHead || !controllerReady()) {
+            dogExitCritical(state);
+            return;
+        }
+        _polling=true;
+        uint8_t slot=_queueTail % DOG_LCDhw_QUEUE_SIZE;
+        uint16_t entry=_queueEntry[slot];
+        uint8_t value=_queueData[slot];
+        dogExitCritical(state);
+
+        setRS((entry & 0x8000) ? HIGH : LOW);
+        select();
+        spiShift(value);
+        deselect();
+        DOG_STAT_COUNT(countCsbEdges(2));
+
+        state=dogEnterCritical();
+        setBusy(entry & 0x7FFF);
+        _queueTail++;
+        _polling=false;
+        dogExitCritical(state);
+    }
 }
 
-void DogLcdhw::spiTransfer(uint8_t value, int executionTime) {
+void DogLcdhw::waitIdle() {
+    // small steps, so a timer interrupt calling poll() as well gets its turn
+    while(queueDepth()>0) {
+        pollWaiting();
+        dogDelayMicroseconds(1);
+        DOG_STAT_COUNT(countBlocking(1));
+    }
+}
+
+void DogLcdhw::pollWaiting() {
+    if(_pollBus!=NULL)
+        _pollBus(_bus);
+    else
+        poll();
+}
+
+unsigned long DogLcdhw::busyMicros() {
+    // poll() may be setting these from an interrupt handler
+    dogIrqState state=dogEnterCritical();
+    unsigned long elapsed=dogMicros()-_busySince;
+    unsigned long busyFor=_busyFor;
+    dogExitCritical(state);
+    return elapsed<busyFor ? busyFor-elapsed : 0;
+}
+
+bool DogLcdhw::setPacedDma(bool on) {
+    DOG_API_SCOPE(DOG_STAT_MODE);
+#if defined(DOG_LCDhw_DMA)
+    waitDma();
+    _pacedDma=on && _hardware && pacedClock(_shortMicros)!=0;
+    return _pacedDma==on;
+#else
+    return !on;
+#endif
+}
+
+#if defined(DOG_LCDhw_DMA)
+DogLcdhw *DogLcdhw::_dmaDisplay=NULL;
+volatile bool DogLcdhw::_dmaRunning=false;
+
+uint32_t DogLcdhw::pacedClock(int executionTime) {
+    // eight clock periods per byte
+    return dogSpiPacedClock(8000000UL/executionTime);
+}
+
+void DogLcdhw::dmaBurst(const uint8_t *values, size_t len, int rs, int executionTime) {
+    DOG_TRACE_SCOPE("dmaBurst");
+    uint32_t clock=pacedClock(executionTime);
+    while(len>0) {
+        size_t n=(len<DOG_LCDhw_DMA_SIZE) ? len : DOG_LCDhw_DMA_SIZE;
+        waitDma();
+        memcpy(_dmaBuffer,values,n);
+        setRS(rs);
+        waitReady();
+        // every byte is executed while the next one is on the wire, so
+        // the bytes can follow each other without a break
+        dogSpiBegin(clock,_dataMode,_bitOrder);
+        dogFastPinLow(_fastCSB);
+#if defined(DOG_LCDhw_STATS)
+        for(size_t i=0; i<n; i++)
+            _stats.countByte(values[i],rs);
+        _stats.countCsbEdges(2);
+#endif
+        _dmaExecution=executionTime;
+        setBusy((n+1)*executionTime);
+        _dmaDisplay=this;
+        _dmaRunning=true;
+        dogSpiDma(_dmaBuffer,n,dmaDone);
+        values+=n;
+        len-=n;
+    }
+}
+
+void DogLcdhw::dmaDone() {
+    // the last byte is complete, the controller executes it from now
+    _dmaDisplay->_dmaDoneAt=dogMicros();
+    _dmaRunning=false;
+}
+#endif
 
-    digitalWrite(lcdCSB,LOW);
+bool DogLcdhw::finishDma() {
+#if defined(DOG_LCDhw_DMA)
+    DogLcdhw *lcd=_dmaDisplay;
+    if(lcd==NULL)
+        return true;
+    if(_dmaRunning)
+        return false;
+    dogFastPinHigh(lcd->_fastCSB);
+    dogSpiEnd();
+    lcd->_busySince=lcd->_dmaDoneAt;
+    lcd->_busyFor=lcd->_dmaExecution;
+    _dmaDisplay=NULL;
+#endif
+    return true;
+}
 
+void DogLcdhw::waitDma() {
+    while(!finishDma()) {
+        dogDelayMicroseconds(1);
+        DOG_STAT_COUNT(countBlocking(1));
+    }
+}
+
+void DogLcdhw::enqueue(uint8_t value, int rs, int executionTime) {
+    // a full queue makes the caller wait for the oldest entry to go out
+    while(queueDepth()>=DOG_LCDhw_QUEUE_SIZE) {
+        pollWaiting();
+        dogDelayMicroseconds(1);
+        DOG_STAT_COUNT(countBlocking(1));
+    }
+    uint8_t slot=_queueHead % DOG_LCDhw_QUEUE_SIZE;
+    _queueData[slot]=value;
+    _queueEntry[slot]=(rs==HIGH ? 0x8000 : 0) | (executionTime & 0x7FFF);
+    // publish the entry only once it is complete
+    dogIrqState state=dogEnterCritical();
+    _queueHead++;
+    dogExitCritical(state);
+}
+
+inline void DogLcdhw::shiftBit(uint8_t bit) {
+    if(bit)
+        dogFastPinHigh(_fastSI);
+    else
+        dogFastPinLow(_fastSI);
+    dogFastPinLow(_fastCLK);
+    dogFastPinHigh(_fastCLK);
+}
+
+void DogLcdhw::spiShift(uint8_t value) {
     if (_hardware){
         // Let hardware SPI handle it
-        SPI.transfer(value);
+        dogSpiTransfer(value);
     } else {
-        // Otherwise, let the software bit-bang it
-        digitalWrite(lcdCLK,HIGH);
-        for(int i=7;i>=0;i--) {
-            if(bitRead(value,i)) {
-                digitalWrite(lcdSI,HIGH);
-            }
-            else {
-                digitalWrite(lcdSI,LOW);
-            }
-            digitalWrite(lcdCLK,LOW);
-            digitalWrite(lcdCLK,HIGH);
-        }
+        // Otherwise, let the software bit-bang it, MSB first. CLK
+        // idles HIGH and the display samples SI on its rising edge.
+        shiftBit(value & 0x80);
+        shiftBit(value & 0x40);
+        shiftBit(value & 0x20);
+        shiftBit(value & 0x10);
+        shiftBit(value & 0x08);
+        shiftBit(value & 0x04);
+        shiftBit(value & 0x02);
+        shiftBit(value & 0x01);
     }
+}
 
-    digitalWrite(lcdCSB,HIGH);
-    delayMicroseconds(executionTime);
+#if defined(DOG_LCDhw_STATS)
+void DogLcdhw::resetStats() {
+    _stats.reset();
 }
+#endif
@@ -56,7 +56,16 @@
 #elif defined(ARDUINO)
 #include <inttypes.h>
 #include "Print.h"
+#else
+#include "hal_host.h"
 #endif
+#include "do_DogLcd_hal.h"
+#include "do_DogLcdStats.h"
+#include "do_DogLcdTrace.h"
+
+/* the hook at the start of every public call, for the statistics and
+ * the trace (both compiled out by default) */
+#define DOG_API_SCOPE(group) DOG_STAT_SCOPE(group); DOG_TRACE_SCOPE(__func__)
 
 /** Define the available models */
 #define DOG_LCDhw_M081 1
@@ -73,6 +82,145 @@
 #define GOOD_3V3_GAIN 3
 #define GOOD_3V3_CONTRAST 50
 
+/**
+ * Model-dependent parameters, one specialization per model.
+ * rows, cols - the visible characters
+ * memSize - the DDRAM (characters) on each row
+ * start(row) - the DDRAM address of the first character on a row
+ * biasAndFx - the bias set command (FX selects the 3-line mode)
+ * functionSet - the function set command, 8-bit, number of lines,
+ *   to be or'ed with the instruction table
+ */
+template <int MODEL> struct DogLcdModel;
+
+template <> struct DogLcdModel<DOG_LCDhw_M081> {
+    enum { rows=1, cols=8, memSize=80, biasAndFx=0x14, functionSet=0x30 };
+    static constexpr uint8_t start(int) { return 0; }
+};
+
+template <> struct DogLcdModel<DOG_LCDhw_M162> {
+    enum { rows=2, cols=16, memSize=40, biasAndFx=0x14, functionSet=0x38 };
+    static constexpr uint8_t start(int row) { return row*0x40; }
+};
+
+template <> struct DogLcdModel<DOG_LCDhw_M163> {
+    enum { rows=3, cols=16, memSize=16, biasAndFx=0x15, functionSet=0x38 };
+    static constexpr uint8_t start(int row) { return row*0x10; }
+};
+
+/**
+ * Voltage-dependent parameters, one specialization per supply voltage.
+ * boosterMode - the booster bit of the power/contrast command
+ * bias - or'ed into the bias set command
+ * contrast, gain - defaults that seem to work
+ */
+template <int VCC> struct DogLcdSupply;
+
+template <> struct DogLcdSupply<DOG_LCDhw_VCC_5V> {
+    enum { boosterMode=0x00, bias=0x08, contrast=GOOD_5V_CONTRAST, gain=GOOD_5V_GAIN };
+};
+
+template <> struct DogLcdSupply<DOG_LCDhw_VCC_3V3> {
+    enum { boosterMode=0x04, bias=0x00, contrast=GOOD_3V3_CONTRAST, gain=GOOD_3V3_GAIN };
+};
+
+/** the default clock of the hardware SPI in Hz, DIV4 on the Arduino
+ *  (Uno) and DIV32 on the Particle Core, see DogLcdhw::configure() */
+#ifndef DOG_LCDhw_SPI_CLOCK
+#if defined(ARDUINO)
+#define DOG_LCDhw_SPI_CLOCK 4000000UL
+#else
+#define DOG_LCDhw_SPI_CLOCK 2250000UL
+#endif
+#endif
+
+/** the oscillator frequency of the ST7036 in Hz, 380kHz typical */
+#ifndef DOG_LCDhw_FOSC
+#define DOG_LCDhw_FOSC 380000UL
+#endif
+
+/** added to every execution time, in percent. 14 turns the 26.3us of
+ *  most instructions into the 30us the driver has always waited */
+#ifndef DOG_LCDhw_TIMING_MARGIN
+#define DOG_LCDhw_TIMING_MARGIN 14
+#endif
+
+/**
+ * Execution times of the ST7036 instructions (datasheet, instruction
+ * table) in oscillator clocks. The datasheet has only two: clear
+ * display and return home take 1.08ms at 380kHz, every other
+ * instruction and a data write is short, 26.3us.
+ */
+#define DOG_LCDhw_CLOCKS_CLEAR_HOME 410
+#define DOG_LCDhw_CLOCKS_SHORT 10
+
+/** the execution time of an instruction, in oscillator clocks */
+static constexpr uint16_t dogInstructionClocks(uint8_t cmd) {
+    // 0x01 clear display, 0x02/0x03 return home, in every instruction table
+    return (cmd>=0x01 && cmd<=0x03) ? DOG_LCDhw_CLOCKS_CLEAR_HOME : DOG_LCDhw_CLOCKS_SHORT;
+}
+
+/** an execution time in microseconds (rounded up) for an oscillator
+ *  frequency in Hz and a margin in percent. Below DOG_LCDhw_FOSC_MIN
+ *  the time of clear and home doesn't fit and is cut to 65535us. */
+static constexpr uint16_t dogExecutionMicros(uint16_t clocks, uint32_t fosc, uint8_t margin) {
+    return ((uint32_t)clocks*(100+margin)*10000UL+fosc-1)/fosc>0xFFFFUL
+        ? 0xFFFF : ((uint32_t)clocks*(100+margin)*10000UL+fosc-1)/fosc;
+}
+
+/** the lowest oscillator frequency in Hz whose execution times (with
+ *  a margin in percent) fit into 16 bits, about 7.1kHz at 14% */
+#define DOG_LCDhw_FOSC_MIN(margin) \
+    (((uint32_t)DOG_LCDhw_CLOCKS_CLEAR_HOME*(100+(margin))*10000UL+0xFFFEUL)/0xFFFFUL)
+
+static_assert(DOG_LCDhw_FOSC>=DOG_LCDhw_FOSC_MIN(DOG_LCDhw_TIMING_MARGIN),
+              "DOG_LCDhw_FOSC is too low for the execution times to fit");
+
+/** largest run of bytes sent as one DMA transfer (see
+ *  DogLcdhw::setPacedDma()), and the shortest worth one */
+#ifndef DOG_LCDhw_DMA_SIZE
+#define DOG_LCDhw_DMA_SIZE 80
+#endif
+#ifndef DOG_LCDhw_DMA_MIN
+#define DOG_LCDhw_DMA_MIN 4
+#endif
+
+/** number of bytes the transmit queue (see setAsync()) holds,
+ *  a power of two no larger than 128 */
+#ifndef DOG_LCDhw_QUEUE_SIZE
+#define DOG_LCDhw_QUEUE_SIZE 32
+#endif
+
+/**
+ * The bytes a DogLcdGroup (see do_DogLcdGroup.h) collects from its
+ * first display during a shared call, to send them to all at once.
+ * Entries are the byte and its execution time, with bit 15 set for data,
+ * like in the transmit queue.
+ */
+struct DogLcdCaptureBuffer {
+    uint8_t *data;
+    uint16_t *entry;
+    uint8_t size;
+    uint8_t length;
+};
+
+/**
+ * How a display takes part in a shared call of a DogLcdGroup. The first
+ * display (the leader) fills the buffer, the others check that they
+ * would send the same bytes. A display that can't go along sends on
+ * its own from then on.
+ */
+struct DogLcdCapture {
+    DogLcdCaptureBuffer *buffer;
+    bool leader;
+    /** the bytes of the buffer this display would send as well */
+    uint8_t matched;
+    bool alone;
+};
+
+/** size of the DDRAM shadow - large enough for the biggest model (M081, 1x80) */
+#define DOG_LCDhw_DDRAM_SIZE 80
+
 /**
  * A class for Dog text LCD's using the
  * SPI-feature of the controller.
@@ -101,6 +249,11 @@ class DogLcdhw : public Print {
     int lcdRS;
     /** The (arduino-)pin used selecting the display */
     int lcdCSB;
+    /** The SI, CLK, CSB and RS pins resolved for direct port access */
+    DogFastPin _fastSI;
+    DogFastPin _fastCLK;
+    DogFastPin _fastCSB;
+    DogFastPin _fastRS;
     /** The (arduino-)pin used for resetting the dislay */
     int lcdRESET;
     /** The (arduino-)pin used for switching the backlight */
@@ -143,24 +296,157 @@ class DogLcdhw : public Print {
      */
     bool _noCharsAdded=true;
 
-    /** for hardware SPI
-     * _clockDivider - convert system clock speed for SPI bus. Arduino Uno system clock
-     * at 16Mhz, Particle Core is at 72Mhz. Maximum serial clock period for ST7036 controller
-     * is 5Mhz (see notes).
+    /** for hardware SPI, applied whenever the driver takes the bus
+     * _clockSpeed - the SPI clock in Hz. Arduino Uno system clock at 16Mhz, Particle Core
+     * is at 72Mhz, the clock is derived from it with a divider. Maximum serial clock for
+     * the ST7036 controller is 5Mhz (see notes).
      *
      * _dataMode - For Mode0, CPOL=0 and CPHA=0, such that "The data must be available before the
      * first clock signal rising. The clock idle state is zero. The data on MISO and MOSI lines
      * must be stable while the clock is high and can be changed when the clock is low. The data is
      * captured on the clock's low-to-high transition and propagated on high-to-low
      * clock transition." (See http://dlnware.com/theory/SPI-Transfer-Modes). For Mode3, CPOL=1 and
-     * CPHA=1. Both seem to work, so far (Arduino Uno).
+     * CPHA=1. Both seem to work, so far (Arduino Uno). Kept as 0..3.
      *
      * _bitOrder - MSBFIRST, most significant bit first
      */
-    uint8_t _clockDivider;
+    uint32_t _clockSpeed;
     uint8_t _dataMode;
     uint8_t _bitOrder;
 
+    /** RAM shadow of the display DDRAM, one byte per cell, indexed
+     *  as row*memSize+col. _frame holds what has been drawn, _shown
+     *  what the controller actually holds. A cell is dirty when the
+     *  two differ.
+     */
+    uint8_t _frame[DOG_LCDhw_DDRAM_SIZE];
+    uint8_t _shown[DOG_LCDhw_DDRAM_SIZE];
+    /** the shadow index the next character is drawn to */
+    int _framePos=0;
+    /** when set, drawing calls only update the shadow until flush() */
+    bool _buffered=false;
+    /** The priority of each cell for flush(maxMicros), and the round
+     *  of flush(maxMicros) in which a cell became dirty. A cell's age
+     *  is the number of rounds since then, up to 255.
+     */
+    uint8_t _priority[DOG_LCDhw_DDRAM_SIZE]={0};
+    uint8_t _dirtySince[DOG_LCDhw_DDRAM_SIZE];
+    uint8_t _flushRound=0;
+
+    /** The controller is busy executing the last byte sent for _busyFor
+     *  microseconds from _busySince (micros()). Instead of waiting right
+     *  after every transfer, the driver waits for whatever is left of
+     *  this time at the start of the next one, so the application's own
+     *  work overlaps with the controller's execution time.
+     */
+    unsigned long _busySince=0;
+    unsigned long _busyFor=0;
+
+    /** What the controller was last told: the instruction table, bias,
+     *  power/contrast-high, contrast-low, follower (gain), display control
+     *  and entry mode commands. Commands that would not change any of
+     *  these are not sent. 0xFF means unknown.
+     */
+    uint8_t _sentTable=0xFF;
+    uint8_t _sentBias=0xFF;
+    uint8_t _sentPower=0xFF;
+    uint8_t _sentContrast=0xFF;
+    uint8_t _sentFollower=0xFF;
+    uint8_t _sentDisplay=0xFF;
+    uint8_t _sentEntry=0xFF;
+    /** The shadow index the controller's DDRAM address counter points
+     *  at, following the auto-increment (or decrement) on every data
+     *  byte. -1 if unknown or pointing into CGRAM.
+     */
+    int _address=-1;
+    /** The display shift in cells to the left, 0..memSize-1, as moved
+     *  by scrollDisplayLeft/Right() and showPage(). -1 if unknown, e.g.
+     *  after autoscroll.
+     */
+    int _shift=-1;
+    /** a buffered clear() or home() took the display shift back, the
+     *  next flush() sends the return home */
+    bool _homePending=false;
+    /** the page setCursor(), clear() and home() work on, -1 for none */
+    int _drawPage=-1;
+
+    /** RAM shadow of the 8 user-defined characters in CGRAM, with a bit
+     *  in _cgramKnown for each slot whose content is known.
+     */
+    uint8_t _cgram[64];
+    uint8_t _cgramKnown=0;
+
+    /** Where the (re)initialization of the display stands, see
+     *  startReset(). The current step waits for _initFor microseconds
+     *  from _initSince (micros()).
+     */
+    enum {
+        INIT_READY,
+        INIT_RESET_LOW,
+        INIT_RESET_HIGH,
+        INIT_POWER_WAIT,
+        INIT_SENDING
+    };
+    uint8_t _initState=INIT_READY;
+    unsigned long _initSince=0;
+    unsigned long _initFor=0;
+
+    /** Transmit queue for the asynchronous mode. Entries are the byte and
+     *  its execution time in microseconds, with bit 15 set for data (RS
+     *  HIGH). The head is only moved by the caller, the tail only by
+     *  poll(), which may run in an interrupt handler.
+     */
+    bool _async=false;
+    uint8_t _queueData[DOG_LCDhw_QUEUE_SIZE];
+    uint16_t _queueEntry[DOG_LCDhw_QUEUE_SIZE];
+    volatile uint8_t _queueHead=0;
+    volatile uint8_t _queueTail=0;
+    /** poll() is sending the byte at the tail */
+    volatile bool _polling=false;
+#if defined(DOG_LCDhw_DMA)
+    /** runs of bytes go out as clock-paced DMA transfers */
+    bool _pacedDma=false;
+    /** what the controller needs for the last byte of the transfer */
+    int _dmaExecution;
+    /** when the last byte of the transfer was complete, set by dmaDone() */
+    volatile unsigned long _dmaDoneAt;
+    /** the bytes of the running transfer, the caller's may be gone */
+    uint8_t _dmaBuffer[DOG_LCDhw_DMA_SIZE];
+    /** The display whose transfer has the hardware SPI, NULL if none.
+     *  There is one SPI, so all displays wait for it. It is only given
+     *  back by finishDma(), outside the completion interrupt.
+     */
+    static DogLcdhw *_dmaDisplay;
+    /** the transfer of _dmaDisplay is still going out, cleared by dmaDone() */
+    static volatile bool _dmaRunning;
+#endif
+    /** the execution times in microseconds the driver waits for, see
+     *  setTiming(): of a data write or any short instruction, and of
+     *  clear display and return home */
+    uint16_t _shortMicros=dogExecutionMicros(DOG_LCDhw_CLOCKS_SHORT,DOG_LCDhw_FOSC,DOG_LCDhw_TIMING_MARGIN);
+    uint16_t _clearHomeMicros=dogExecutionMicros(DOG_LCDhw_CLOCKS_CLEAR_HOME,DOG_LCDhw_FOSC,DOG_LCDhw_TIMING_MARGIN);
+    /** Polls the bus this display shares with others (see
+     *  do_DogLcdBus.h), NULL if none. Waiting for the queue then polls
+     *  all of them.
+     */
+    void (*_pollBus)(void *bus)=NULL;
+    void *_bus=NULL;
+    friend class DogLcdBus;
+
+    /** while a DogLcdGroup makes a shared call, where the bytes go
+     *  instead of the display, NULL otherwise */
+    DogLcdCapture *_capture=NULL;
+    friend class DogLcdGroup;
+
+#if defined(DOG_LCDhw_STATS)
+    /** what the driver has sent and how long its calls took */
+    DogLcdStats _stats;
+#endif
+#if defined(DOG_LCDhw_TRACE)
+    /** the track of the trace the events of this display go to */
+    uint8_t _traceTrack;
+#endif
+
  public:
     /**
      * Creates a new instance of DogLcd and asigns the (arduino-)pins
@@ -168,7 +454,8 @@ class DogLcdhw : public Print {
      * @param lcdSI The (arduino-)pin connected to the SI-pin on the display
      * @param lcdCLK The (arduino-)pin connected to the CLK-pin on the display
      * @param lcdCSB The (arduino-)pin connected to the CSB-pin on the display
-     *        [note: order of pins changed from DogLcd source]
+     *        [note: order of pins changed from DogLcd source]. With
+     *        hardware SPI, -1 selects the SS pin.
      * @param lcdRS The (arduino-)pin connected to the RS-pin on the display
      * @param backLight If you hardware supports switching the backlight
      * on the display from software this is the (arduino-)pin to be used.
@@ -176,9 +463,17 @@ class DogLcdhw : public Print {
      * software this is the (arduino-)pin where the RESET-pin of
      * the display is connected. If you don't need this feature simply
      * connect the RESET-pin on the display to VCC.
+     * @param spiClock the clock of the hardware SPI in Hz, rounded down
+     * to what the SPI can do
+     * @param spiMode the SPI mode of the hardware SPI, 0..3
+     *
+     * The hardware SPI is only taken (with SPI.beginTransaction() where
+     * the SPI library has it) while bytes go out to the display, so
+     * other devices on the bus can use settings of their own.
      */
     DogLcdhw(int lcdSI, int lcdCLK, int lcdCSB, int lcdRS,
-	   int lcdRESET=-1, int backLight=-1);
+	   int lcdRESET=-1, int backLight=-1,
+	   uint32_t spiClock=DOG_LCDhw_SPI_CLOCK, int spiMode=3);
 
     /**
      * Resets and initializes the Display.
@@ -204,11 +499,36 @@ class DogLcdhw : public Print {
      */
     int begin(int model, int vcc=DOG_LCDhw_VCC_3V3, int contrast=0, int gain=0);
 
+    /**
+     * Like begin(), but only starts the initialization and returns
+     * right away. The reset and power-up waits run in the background
+     * while poll() is called, and isReady() tells when the display can
+     * be used. Drawing calls made before that wait for the display.
+     * @param warmStart set this if the display kept its power while
+     * the processor restarted. The reset and its waits are skipped
+     * and the initialization sequence is sent right away.
+     * @return 0 if the parameters are valid, -1 otherwise.
+     */
+    int beginAsync(int model, int vcc=DOG_LCDhw_VCC_3V3, int contrast=0, int gain=0,
+                   bool warmStart=false);
+
     /**
      * Reset the display.
      */
     void reset();
 
+    /**
+     * Start resetting the display without waiting for it, see
+     * beginAsync().
+     * @param warmStart skip the reset and its waits
+     */
+    void startReset(bool warmStart=false);
+
+    /**
+     * Whether the display has finished its initialization
+     */
+    bool isReady();
+
     /**
      * Set the contrast for the display.
      * @param contrast the contrast to be used for the display. Setting
@@ -317,7 +637,18 @@ class DogLcdhw : public Print {
      * @param charMap an array of 8 bytes that contains the char
      * definition.
      */
-    void createChar(int charCode, uint8_t charMap[]);
+    void createChar(int charCode, const uint8_t charMap[]);
+
+    /**
+     * Load a number of consecutive user-defineable chars at once. Only
+     * the rows that differ from what CGRAM holds are sent, with one CGRAM
+     * address command per run of rows. Unlike createChar() the cursor
+     * stays where it is.
+     * @param firstSlot the code of the first char, 0..7
+     * @param count the number of chars, firstSlot+count must not exceed 8
+     * @param maps count arrays of 8 bytes with the char definitions
+     */
+    void loadGlyphs(int firstSlot, int count, const uint8_t (*maps)[8]);
 
     /**
      * Set the cursor to a new loaction.
@@ -325,10 +656,154 @@ class DogLcdhw : public Print {
      * @param row the row to move the cursor to
      * If the column- or row-index does exceed
      * the number of columns/rows on the hardware
-     * the cursor stays where it is.
+     * the cursor stays where it is. Nothing is sent if the controller's
+     * address counter already points at the new location.
      */
     void setCursor(int col, int row);
 
+    /**
+     * Get the current cursor location, i.e. where the next character
+     * will be drawn.
+     * @param col receives the column
+     * @param row receives the row
+     */
+    void getCursor(int &col, int &row);
+
+    /** the number of lines of the model */
+    int getRows() { return rows; }
+    /** the number of visible columns of the model */
+    int getColumns() { return cols; }
+    /** the number of cells (DDRAM bytes) per line, visible or not */
+    int getLineLength() { return memSize; }
+    /** the display shift in cells to the left, -1 if unknown (e.g.
+     *  after autoscroll), a return home still to be flushed counts */
+    int getDisplayShift() { return _homePending ? 0 : _shift; }
+
+    /**
+     * Draw a character into a cell without moving the cursor, e.g. into
+     * the part of a line that is shifted out of view.
+     * @param col the column, 0..getLineLength()-1
+     * @param row the row
+     * @param value the character code
+     */
+    void putChar(int col, int row, uint8_t value);
+
+    /**
+     * The number of pages the display memory holds. A page is a screen
+     * full of cells, all lines at the same columns; page n starts at
+     * column n*getColumns(). The M081 has 10 pages, the M162 2 and the
+     * M163 only the one that is visible.
+     */
+    int getPageCount() { return memSize/cols; }
+
+    /**
+     * Draw into a page, e.g. one that is not visible. setCursor(),
+     * getCursor(), clear() and home() then work on the page: columns
+     * count from its first column and clear() only blanks its cells.
+     * Text running past the right edge goes on into the next page.
+     * The cursor moves to the start of the page.
+     * @param page 0..getPageCount()-1, or -1 to address the whole
+     * display memory again
+     * @return false if there is no such page
+     */
+    bool setDrawPage(int page);
+
+    /** the page drawn into, -1 if none, see setDrawPage() */
+    int getDrawPage() { return _drawPage; }
+
+    /**
+     * Make a page visible. Nothing is rewritten, the display is shifted
+     * onto the page with as few display shift commands (30us each) as
+     * the way around the line allows, or returned home first if that is
+     * quicker. The shift moves all lines together, so a page is always
+     * a whole screen. In buffered mode pending changes are flushed
+     * first, so the page appears complete.
+     * @param page 0..getPageCount()-1
+     * @return false if there is no such page
+     */
+    bool showPage(int page);
+
+    /** the visible page, -1 if the display is not shifted onto one */
+    int getShownPage();
+
+    /**
+     * Show the page being drawn into (see setDrawPage()) and go on
+     * drawing into the page that was visible before, or into the next
+     * page if none was. With two pages this is double buffering: draw
+     * the next screen out of view, then flip().
+     */
+    void flip();
+
+    /**
+     * Switch between direct and buffered drawing.
+     * @param buffered if true, print(), write(), setCursor(), clear()
+     * and home() only update the RAM shadow of the display and nothing
+     * is sent until flush() is called. A display shift that clear() or
+     * home() takes back, and the left-to-right entry clear() sets, also
+     * wait for flush(). If false (the default), drawing goes straight to the
+     * display. Switching back to direct drawing flushes any pending
+     * changes first.
+     */
+    void setBuffered(bool buffered);
+
+    /** whether drawing is buffered, see setBuffered() */
+    bool isBuffered() { return _buffered; }
+
+    /**
+     * Send all cells of the shadow that differ from what the display
+     * shows, along the cheapest way found: cursor jumps are only sent
+     * where the controller's own address increment does not already
+     * point at the next changed cell and resending unchanged cells in
+     * between would not be cheaper, and the display is cleared first
+     * if that saves more than the 1.08ms (at 380kHz) it takes.
+     * @return the number of cells sent
+     */
+    int flush();
+
+    /**
+     * Send as many changed cells as fit into a time budget, so a
+     * screen update never takes longer than the slot it is given.
+     * Cells are taken by priority (see setPriority()) and then by how
+     * long they have been waiting, those that don't fit stay changed
+     * for the next call. The display is never cleared to save time,
+     * and the return home of a buffered clear() or home() waits for a
+     * budget it fits into.
+     * @param maxMicros the budget in microseconds of controller
+     * execution time, counted as in estimateMicros()
+     * @return the number of cells sent
+     */
+    int flush(uint32_t maxMicros);
+
+    /**
+     * Set the priority flush(maxMicros) gives to a field of cells, e.g.
+     * to have an alarm go out before anything else. Priorities stay
+     * with the cells until they are set again, the default is 0.
+     * @param col the first column, counted like in setCursor()
+     * @param row the row
+     * @param len the number of cells
+     * @param priority 0..255, higher goes first
+     */
+    void setPriority(int col, int row, int len, uint8_t priority);
+
+    /**
+     * The time (in microseconds of controller execution time) the next
+     * flush() will take, so screen updates can be budgeted in advance.
+     */
+    unsigned long estimateMicros();
+
+    /**
+     * Mark every cell as changed, so the next flush() redraws the whole
+     * display (e.g. after the display lost power).
+     */
+    void invalidate();
+
+    /**
+     * Count the cells that hold a given character code, either in the
+     * shadow or on the display itself (while a flush() is pending).
+     * @param c the character code, e.g. 0..7 for user-defined chars
+     */
+    int countChar(uint8_t c);
+
     /** dmf - issues with the overloaded print() [below]
      *  this from dogm_7036.h
      */
@@ -342,7 +817,7 @@ class DogLcdhw : public Print {
     using Print::write;
 
 
-#if defined (SPARK) || (defined(ARDUINO) && ARDUINO >= 100)
+#if defined (SPARK) || !defined(ARDUINO) || ARDUINO >= 100
     //The Print::write() signature was changed with Arduino versions >= 1.0
 
     /**
@@ -352,14 +827,126 @@ class DogLcdhw : public Print {
      * @param c the character to be printed.
      * @return int number of characters written
      */
-     virtual size_t write(uint8_t c) { writeChar(c); return 1; }
+     virtual size_t write(uint8_t c) {
+         DOG_API_SCOPE(DOG_STAT_WRITE);
+         drawChar(c);
+         return 1;
+     }
+
+    /**
+     * Implements the buffer write()-method from the base-class, so a
+     * string goes out as one burst instead of one write(uint8_t) call
+     * (and one chip select and RS toggle) per character.
+     * @param buffer the characters to be printed.
+     * @param size the number of characters
+     * @return int number of characters written
+     */
+     virtual size_t write(const uint8_t *buffer, size_t size) {
+         DOG_API_SCOPE(DOG_STAT_WRITE);
+         drawChars(buffer,size);
+         return size;
+     }
 
 #elif defined(ARDUINO)
     //This keeps the library compatible with pre-1.0 versions of the Arduino core
-    virtual void write(uint8_t c) { writeChar(c); }
+    virtual void write(uint8_t c) { DOG_API_SCOPE(DOG_STAT_WRITE); drawChar(c); }
+    virtual void write(const uint8_t *buffer, size_t size) { DOG_API_SCOPE(DOG_STAT_WRITE); drawChars(buffer,size); }
 
 #endif
 
+    /**
+     * Switch the asynchronous mode on or off. In asynchronous mode
+     * commands and data are not sent right away but go into a transmit
+     * queue, so print() and friends return in microseconds. The queue
+     * is drained by poll(). A call that finds the queue full waits
+     * for room. Switching back waits until the queue is empty.
+     */
+    void setAsync(bool async);
+
+    /**
+     * Move a running initialization along and send as many queued bytes
+     * as the controller is ready for, without waiting. Call this often
+     * from loop(), or from a timer interrupt (every 30us or so keeps the
+     * display going at full speed). On Particle devices taking the
+     * hardware SPI for a transfer waits for a lock, so there poll() must
+     * be called from loop() (or a thread) when the display is on the
+     * hardware SPI.
+     */
+    void poll();
+
+    /**
+     * The number of bytes waiting in the transmit queue
+     */
+    int queueDepth();
+
+    /**
+     * Wait until everything queued has been sent.
+     */
+    void waitIdle();
+
+    /**
+     * The time in microseconds until the controller has finished
+     * executing the last byte sent, 0 if it is ready for the next.
+     */
+    unsigned long busyMicros();
+
+    /**
+     * Set the timing the driver waits for after each byte. The execution
+     * times of the ST7036 scale with its oscillator, which the datasheet
+     * gives as 380kHz typical but varies with supply voltage, temperature
+     * and part. Measure it (on a display where the OSC pin is
+     * accessible, or by trimming until the simulator's timing check of
+     * the host backend or the display itself complains) and add a margin
+     * instead of padding everything to the worst case.
+     * @param fosc the oscillator frequency in Hz, default DOG_LCDhw_FOSC
+     * @param margin added to every time, in percent, default
+     * DOG_LCDhw_TIMING_MARGIN
+     * @return false (and the timing is kept) if fosc is below
+     * DOG_LCDhw_FOSC_MIN(margin), where the times no longer fit
+     */
+    bool setTiming(uint32_t fosc, uint8_t margin=DOG_LCDhw_TIMING_MARGIN);
+
+    /**
+     * Switch clock-paced DMA bursts on or off, for hardware SPI on the
+     * Photon (and the host). A run of bytes (text from print(), a
+     * flush(), writeData()) is then sent as one DMA transfer with the
+     * SPI clock slowed down so far that a byte takes as long on the
+     * wire as the controller needs to execute it, about 30us, so the
+     * CPU neither waits nor sends while it goes out. The call returns
+     * right away, the next one waits if the transfer hasn't finished.
+     * Single bytes and long commands like clear() still go out at the
+     * normal clock with the CPU waiting the execution time.
+     * The SPI stays taken (and the display selected) until the next
+     * call to this or any other display, or poll(), finds the transfer
+     * complete, so call poll() from loop() if other devices share the
+     * bus.
+     * @return false if there is no DMA to use: software SPI, another
+     * platform, or an SPI that can't go slow enough
+     */
+    bool setPacedDma(bool on);
+
+    /**
+     * Send a run of data bytes to wherever the controller's address
+     * counter points (DDRAM or CGRAM). The display is selected and RS
+     * is set once for the whole run, and the bytes follow each other
+     * with only the execution time the controller needs in between.
+     * This is a raw transfer, it does not update the display shadow -
+     * use write()/print() to draw text.
+     * @param data the bytes to send
+     * @param len the number of bytes
+     */
+    void writeData(const uint8_t *data, size_t len);
+
+    /**
+     * Send a run of commands in one burst, like writeData(). Only
+     * commands with the short execution time (26.3us at 380kHz) may be sent this
+     * way, i.e. not clear or home. As the driver can't tell what they
+     * do, the next mode or contrast change is always sent in full.
+     * @param cmds the commands to send
+     * @param len the number of commands
+     */
+    void writeCommands(const uint8_t *cmds, size_t len);
+
     /**
      * Set the backlight. This is obviously only possible
      * if you have build a small circuit for switching/dimming the
@@ -374,6 +961,19 @@ class DogLcdhw : public Print {
      */
     void setBacklight(int value,bool PWM=false);
 
+#if defined(DOG_LCDhw_STATS)
+    /**
+     * What the driver has sent and how long its calls took since the
+     * last resetStats(), see do_DogLcdStats.h
+     */
+    const DogLcdStats& getStats() { return _stats; }
+
+    /**
+     * Set all counters and histograms back to zero
+     */
+    void resetStats();
+#endif
+
  private:
     /**
      * Set the intruction set to use for the next command
@@ -381,6 +981,126 @@ class DogLcdhw : public Print {
      */
     void setInstructionSet(uint8_t is);
 
+    /**
+     * Send a command that sets controller state, unless the controller
+     * is already in that state.
+     * @param cmd the command
+     * @param sent what was last sent for this state, updated
+     * @param is the instruction table the command belongs to
+     */
+    void writeState(uint8_t cmd, uint8_t &sent, uint8_t is);
+
+    /**
+     * Forget what the controller was last told, so the next state
+     * commands are all sent (e.g. after a reset)
+     */
+    void forgetState();
+
+    /**
+     * Send the clear command and update the shadow and state to match
+     */
+    void writeClear();
+
+    /**
+     * Send the clear command and update the state, but not the shadow
+     */
+    void sendClear();
+
+    /**
+     * Send the return home a buffered clear() or home() has left
+     * pending, if the display is shifted
+     */
+    void sendHome();
+
+    /**
+     * Plan the way flush() sends the changed cells.
+     * @param fromClear plan to clear the display first
+     * @param sent NULL to only plan, otherwise the plan is carried out
+     * and the number of cells sent is added to *sent
+     * @param only a bit per cell, NULL for all - the changed cells to
+     * plan for, others are only sent when that costs nothing extra
+     * @param home false to leave a pending return home for later
+     * @return the time the plan takes in microseconds
+     */
+    unsigned long planFlush(bool fromClear, int *sent, const uint8_t *only=NULL, bool home=true);
+
+    /**
+     * Change a cell of the shadow, noting when it becomes dirty
+     */
+    void setFrame(int index, uint8_t value);
+
+    /**
+     * The order in which flush(maxMicros) takes a dirty cell, higher
+     * first: its priority, then its age
+     */
+    uint16_t urgency(int index);
+
+    /**
+     * Whether clearing the display first makes flush() cheaper
+     */
+    bool clearPays();
+
+    /**
+     * The first column of the page drawn into, 0 if none
+     */
+    int pageOrigin() { return _drawPage<0 ? 0 : _drawPage*cols; }
+
+    /**
+     * Shift the display by a number of cells, to the left if left is
+     * set, with the display shift commands sent as one burst
+     */
+    void shiftDisplay(int cells, bool left);
+
+    /**
+     * Take over the parameters of a model from its DogLcdModel
+     */
+    template <class Model> void setModel() {
+        rows=Model::rows;
+        cols=Model::cols;
+        memSize=Model::memSize;
+        for(int row=0; row<3; row++)
+            startAddress[row]=(row<Model::rows) ? Model::start(row) : -1;
+        biasAndFx=Model::biasAndFx;
+        instructionSetTemplate=Model::functionSet;
+    }
+
+    /**
+     * Write chars to CGRAM, skipping those that are already there
+     */
+    void writeGlyphs(int firstSlot, int count, const uint8_t (*maps)[8]);
+
+    /**
+     * Whether a row of CGRAM (index 0..63) has to be written to hold row,
+     * i.e. it is unknown or different
+     */
+    bool cgramDiffers(int index, uint8_t row);
+
+    /**
+     * Check and store the model, voltage, contrast and gain parameters
+     * and set up the pins, see begin().
+     */
+    int configure(int model, int vcc, int contrast, int gain);
+
+    /**
+     * Wait for the current initialization step
+     */
+    void startInitWait(uint8_t state, unsigned long us);
+
+    /**
+     * Take the next initialization step if its wait is over
+     */
+    void stepReset();
+
+    /**
+     * Wait until the initialization is done
+     */
+    void finishReset();
+
+    /**
+     * Send the initialization sequence
+     */
+    void sendInit();
+
     /* set Bias and Fx during initialization
      */
     void setBiasAndFx();
@@ -392,13 +1112,54 @@ class DogLcdhw : public Print {
     void writeDisplayMode();
 
     /**
-     * Send a command to the display
+     * Draw a character at the current shadow position and advance
+     * the position according to the entry mode. Sent right away
+     * unless buffered drawing is enabled.
+     */
+    void drawChar(uint8_t c);
+
+    /**
+     * Draw a run of characters, sent as one burst unless buffered
+     * drawing is enabled.
+     */
+    void drawChars(const uint8_t *chars, size_t len);
+
+    /**
+     * Set the controller's DDRAM address to the given shadow cell,
+     * unless its address counter already points there
+     * @param index the shadow index (row*memSize+col)
+     */
+    void writeAddress(int index);
+
+    /**
+     * Follow the controller's address counter over len data bytes
+     */
+    void advanceAddress(size_t len);
+
+    /**
+     * The shadow index following index in the current entry direction,
+     * wrapping around at the ends of the shadow.
+     */
+    int nextIndex(int index);
+
+    /**
+     * Fill both shadow buffers with blanks, as after a clear command
+     */
+    void clearShadow();
+
+    /**
+     * Send a command to the display. The hardware needs some time to
+     * execute the instruction just sent, the next byte waits for the
+     * time executionMicros() gives.
      * @param cmd the command to send.
-     * @param executionTime the hardware needs some time to
-     * execute the instruction just send. This is the time in
-     * microseconds the code should wait after trandd´sfrerring the data
      */
-    void writeCommand(uint8_t cmd, int executionTime);
+    void writeCommand(uint8_t cmd);
+
+    /**
+     * The time in microseconds the controller needs to execute a
+     * command, from the timing table and setTiming()
+     */
+    int executionMicros(uint8_t cmd);
 
     /**
      * Send a character to the display
@@ -408,12 +1169,119 @@ class DogLcdhw : public Print {
 
     /**
      * Implements the low-level transfer of the data
-     * to the hardware.
+     * to the hardware, or queues it in asynchronous mode.
+     * @param rs HIGH for data, LOW for commands
      * @param executionTime the hardware needs some time to
      * execute the instruction just send. This is the time in
-     * microseconds the code should wait after trandd´sfrerring the data
+     * microseconds the controller is busy after transferring the data,
+     * the next transfer waits for whatever is left of it.
+     */
+    void spiTransfer(uint8_t c, int rs, int executionTime);
+
+    /**
+     * Hand a byte to the DogLcdGroup making a shared call
+     * @return false if the byte has to be sent by this display alone
+     */
+    bool capture(uint8_t value, int rs, int executionTime);
+
+    /**
+     * Send the first count bytes collected by the group to this display
+     * alone
+     */
+    void sendCaptured(uint8_t count);
+
+    /**
+     * Drive the RS line, HIGH for data, LOW for commands
+     */
+    void setRS(int rs);
+
+    /**
+     * Poll while waiting for the queue: the whole bus if the display
+     * is on one, so the other displays keep going
+     */
+    void pollWaiting();
+
+    /**
+     * Add a byte to the transmit queue, waiting for room if it is full
+     */
+    void enqueue(uint8_t value, int rs, int executionTime);
+
+    /**
+     * Whether the controller has finished executing the last byte
+     */
+    bool controllerReady();
+
+    /**
+     * Transfer a run of bytes with the display selected and RS set
+     * only once.
+     * @param rs HIGH for data, LOW for commands
+     * @param executionTime the time to wait after each byte
+     */
+    void spiBurst(const uint8_t *values, size_t len, int rs, int executionTime);
+
+    /**
+     * Take the hardware SPI with the settings of the display, then pull
+     * CSB LOW
+     */
+    void select();
+
+    /**
+     * Pull CSB HIGH and give the hardware SPI back
+     */
+    void deselect();
+
+    /**
+     * Clock one byte out to the display, which must be selected
+     */
+    void spiShift(uint8_t c);
+
+    /**
+     * Clock one bit out through the software SPI
+     */
+    void shiftBit(uint8_t bit);
+
+#if defined(DOG_LCDhw_DMA)
+    /**
+     * Send a run of bytes as clock-paced DMA transfers, see setPacedDma()
+     */
+    void dmaBurst(const uint8_t *values, size_t len, int rs, int executionTime);
+
+    /**
+     * The SPI clock at which a byte takes executionTime on the wire,
+     * 0 if the SPI can't go that slow
+     */
+    uint32_t pacedClock(int executionTime);
+
+    /**
+     * Completion of the DMA transfer, from its interrupt. It only notes
+     * the time, the bus is given back by finishDma().
+     */
+    static void dmaDone();
+#endif
+
+    /**
+     * If the DMA transfer of any display is complete, deselect that
+     * display and give the hardware SPI back. Not from an interrupt.
+     * @return true if no transfer is running any more
+     */
+    static bool finishDma();
+
+    /**
+     * Wait until no DMA transfer (of any display) is running, before RS
+     * or the bus are touched again
+     */
+    void waitDma();
+
+    /**
+     * Note that the controller is busy for executionTime microseconds
+     * from now
+     */
+    void setBusy(int executionTime);
+
+    /**
+     * Wait until the controller has finished executing the last byte
      */
-    void spiTransfer(uint8_t c, int executionTime);
+    void waitReady();
 };
 
 #endif
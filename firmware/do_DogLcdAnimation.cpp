@@ -0,0 +1,80 @@
+/* dmf
+ * do_DogLcdAnimation - animated custom characters on a DogLcdhw
+ * See do_DogLcdAnimation.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include "do_DogLcdAnimation.h"
+#include "do_DogLcd_hal.h"
+
+DogLcdAnimation::DogLcdAnimation(DogLcdhw &lcd) : lcd(lcd) {
+    for(int slot=0; slot<8; slot++)
+        frames[slot]=NULL;
+    nextSlot=0;
+}
+
+bool DogLcdAnimation::play(uint8_t slot, const uint8_t (*frames)[8], uint8_t frameCount,
+                           uint16_t periodMs, bool loop) {
+    if(slot>7 || frames==NULL || frameCount<1 || periodMs<1)
+        return false;
+    this->frames[slot]=frames;
+    this->frameCount[slot]=frameCount;
+    this->loop[slot]=loop;
+    period[slot]=periodMs;
+    frame[slot]=0;
+    shownAt[slot]=dogMillis();
+    lcd.loadGlyphs(slot,1,frames);
+    return true;
+}
+
+void DogLcdAnimation::stop(uint8_t slot) {
+    if(slot<8)
+        frames[slot]=NULL;
+}
+
+bool DogLcdAnimation::isPlaying(uint8_t slot) {
+    return slot<8 && frames[slot]!=NULL;
+}
+
+void DogLcdAnimation::poll(unsigned long maxMicros) {
+    unsigned long start=dogMicros();
+    unsigned long now=dogMillis();
+    for(int i=0; i<8; i++) {
+        int slot=(nextSlot+i) & 0x07;
+        if(frames[slot]==NULL)
+            continue;
+        // unsigned difference, so this survives millis() wrapping
+        unsigned long late=now-shownAt[slot];
+        if(late<period[slot])
+            continue;
+        if(dogMicros()-start>=maxMicros) {
+            // out of time, this slot goes first next time
+            nextSlot=slot;
+            break;
+        }
+        if(frame[slot]+1<frameCount[slot]) {
+            frame[slot]++;
+        } else if(loop[slot]) {
+            frame[slot]=0;
+        } else {
+            frames[slot]=NULL;
+            continue;
+        }
+        // keep the pace, unless we are so late that catching up would
+        // only show a burst of frames
+        if(late<2UL*period[slot])
+            shownAt[slot]+=period[slot];
+        else
+            shownAt[slot]=now;
+        // only the rows that differ from the previous frame are sent
+        lcd.loadGlyphs(slot,1,&frames[slot][frame[slot]]);
+    }
+    lcd.poll();
+}
@@ -0,0 +1,98 @@
+/* dmf
+ * do_DogLcdAnimation - animated custom characters on a DogLcdhw
+ *
+ * Every cell on the display that shows a user-defined character changes
+ * as soon as its CGRAM slot is rewritten. DogLcdAnimation plays a
+ * sequence of frames into a slot, so any number of spinners, battery or
+ * signal icons printed with that character code move together, at the
+ * cost of rewriting (only the changed rows of) one 5x8 bitmap per frame
+ * instead of reprinting every cell.
+ *
+ *   const uint8_t spinner[4][8]={...};
+ *   DogLcdAnimation anim(lcd);
+ *   anim.play(0,spinner,4,125);
+ *   lcd.setCursor(15,0);
+ *   lcd.write((uint8_t)0);
+ *   ...
+ *   void loop() { anim.poll(); }
+ *
+ * Slots used for animations should be left out of a DogLcdGlyphs cache
+ * on the same display (see its firstSlot and slots).
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_ANIMATION_h
+#define do_DOG_LCD_ANIMATION_h
+
+#include "do_DogLcd.h"
+
+/** the default time poll() may spend on rewriting frames, in microseconds */
+#ifndef DOG_ANIMATION_BUDGET
+#define DOG_ANIMATION_BUDGET 500
+#endif
+
+class DogLcdAnimation {
+ public:
+    /**
+     * Creates an animation engine on a display.
+     * @param lcd the display, begin() must be called before play()
+     */
+    DogLcdAnimation(DogLcdhw &lcd);
+
+    /**
+     * Start playing a sequence of frames into a CGRAM slot. The first
+     * frame is loaded right away.
+     * @param slot the character code (0..7) to animate
+     * @param frames frameCount bitmaps of 8 rows, like for createChar().
+     * Only the pointer is kept, the frames must stay around.
+     * @param frameCount the number of frames
+     * @param periodMs how long each frame is shown
+     * @param loop true to start over after the last frame, false to stop
+     * on the last frame
+     * @return false if the arguments are invalid
+     */
+    bool play(uint8_t slot, const uint8_t (*frames)[8], uint8_t frameCount,
+              uint16_t periodMs, bool loop=true);
+
+    /**
+     * Stop the animation of a slot, the current frame stays in CGRAM.
+     */
+    void stop(uint8_t slot);
+
+    /**
+     * Whether a slot is being animated
+     */
+    bool isPlaying(uint8_t slot);
+
+    /**
+     * Advance the animations that are due and then let the display
+     * work its queue (DogLcdhw::poll()). Call this from loop().
+     * @param maxMicros the time to spend on rewriting frames. When it
+     * is used up the other due slots wait for the next call, starting
+     * with the first one that missed out.
+     */
+    void poll(unsigned long maxMicros=DOG_ANIMATION_BUDGET);
+
+ private:
+    DogLcdhw &lcd;
+
+    /** the frames of each slot, NULL if the slot is not animated */
+    const uint8_t (*frames[8])[8];
+    uint8_t frameCount[8];
+    uint8_t frame[8];
+    bool loop[8];
+    uint16_t period[8];
+    /** when the current frame of each slot was due */
+    unsigned long shownAt[8];
+    /** the slot poll() looks at first */
+    uint8_t nextSlot;
+};
+
+#endif
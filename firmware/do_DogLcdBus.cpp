@@ -0,0 +1,100 @@
+/* dmf
+ * do_DogLcdBus - several displays on one SPI bus, kept busy together
+ * See do_DogLcdBus.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include "do_DogLcdBus.h"
+#include "do_DogLcd_hal.h"
+
+DogLcdBus::DogLcdBus() {
+    count=0;
+}
+
+bool DogLcdBus::add(DogLcdhw &lcd, uint8_t priority) {
+    if(count>=DOG_LCDbus_MAX_PANELS)
+        return false;
+    lcd.setAsync(true);
+    lcd._pollBus=pollBus;
+    lcd._bus=this;
+    // keep the list sorted, a new display goes after those of equal priority
+    int i=count;
+    while(i>0 && this->priority[i-1]<priority) {
+        panels[i]=panels[i-1];
+        this->priority[i]=this->priority[i-1];
+        i--;
+    }
+    panels[i]=&lcd;
+    this->priority[i]=priority;
+    count++;
+    // the groups may have moved, their turns start over
+    for(int k=0; k<count; k++)
+        turn[k]=0;
+    return true;
+}
+
+void DogLcdBus::poll() {
+    /* Each display sends the byte it is ready for, if any, and the
+     * next one is only ready once it has executed that, so one pass
+     * interleaves the displays byte by byte. Within a group of equal
+     * priority the pass starts at the next display every time. A group
+     * with bytes left keeps the bus from the groups below it.
+     */
+    int first=0;
+    while(first<count) {
+        int end=first+1;
+        while(end<count && priority[end]==priority[first])
+            end++;
+        int size=end-first;
+        bool busy=false;
+        for(int k=0; k<size; k++) {
+            DogLcdhw *lcd=panels[first+(turn[first]+k)%size];
+            lcd->poll();
+            if(lcd->queueDepth()>0)
+                busy=true;
+        }
+        turn[first]=(turn[first]+1)%size;
+        if(busy)
+            return;
+        first=end;
+    }
+}
+
+void DogLcdBus::pollBus(void *bus) {
+    ((DogLcdBus*)bus)->poll();
+}
+
+int DogLcdBus::queueDepth() {
+    int depth=0;
+    for(int i=0; i<count; i++)
+        depth+=panels[i]->queueDepth();
+    return depth;
+}
+
+void DogLcdBus::waitIdle() {
+    while(true) {
+        poll();
+        // sleep until the first display with something left is ready
+        unsigned long wait=0;
+        bool pending=false;
+        for(int i=0; i<count; i++) {
+            if(panels[i]->queueDepth()==0)
+                continue;
+            unsigned long busy=panels[i]->busyMicros();
+            if(!pending || busy<wait)
+                wait=busy;
+            pending=true;
+        }
+        if(!pending)
+            return;
+        // at least a little, so a timer interrupt calling poll() gets its turn
+        dogDelayMicroseconds(wait>0 ? wait : 1);
+    }
+}
@@ -0,0 +1,89 @@
+/* dmf
+ * do_DogLcdBus - several displays on one SPI bus, kept busy together
+ *
+ * Every display needs about 30us to execute a byte, while sending one
+ * over the hardware SPI takes a few microseconds. A display on its own
+ * leaves the bus idle for most of the time. DogLcdBus puts the displays
+ * sharing a bus (each with its own CSB pin) into asynchronous mode and
+ * hands the bus to whichever display is ready for its next byte, so
+ * their execution times overlap and N displays are written almost N
+ * times as fast as one after the other.
+ *
+ *   DogLcdhw lcd1(0, 0, 12, 11), lcd2(0, 0, 9, 11), lcd3(0, 0, 8, 11);
+ *   DogLcdBus bus;
+ *   ...
+ *   bus.add(lcd1);
+ *   bus.add(lcd2);
+ *   bus.add(lcd3, 1);   // goes first whenever it has something to send
+ *   lcd1.print("one"); lcd2.print("two"); lcd3.print("three");
+ *   bus.waitIdle();     // or call bus.poll() from loop() or a timer
+ *
+ * Displays with the same priority take turns, byte by byte, and a
+ * lower priority only gets the bus once all above it are done. A display
+ * whose queue is full while it is drawn into keeps the whole bus going
+ * while it waits for room. The displays may share the RS line.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_BUS_h
+#define do_DOG_LCD_BUS_h
+
+#include "do_DogLcd.h"
+
+/** the number of displays a bus can take */
+#ifndef DOG_LCDbus_MAX_PANELS
+#define DOG_LCDbus_MAX_PANELS 8
+#endif
+
+class DogLcdBus {
+ public:
+    DogLcdBus();
+
+    /**
+     * Put a display on the bus and switch it to asynchronous mode.
+     * @param lcd the display, with its own CSB pin
+     * @param priority displays with a higher priority are served first
+     * @return false if the bus is full
+     */
+    bool add(DogLcdhw &lcd, uint8_t priority=0);
+
+    /**
+     * Send the next byte of every display that is ready for one, the
+     * displays with the highest priority first. While displays of a
+     * priority have bytes left, those below it wait. Call this often
+     * from loop(), or from a timer interrupt.
+     */
+    void poll();
+
+    /**
+     * The number of bytes waiting on all displays together
+     */
+    int queueDepth();
+
+    /**
+     * Wait until every display has sent everything queued. Between the
+     * bytes it sleeps until the first display is ready again.
+     */
+    void waitIdle();
+
+ private:
+    /** poll() for the displays waiting for room in their queue */
+    static void pollBus(void *bus);
+
+    /** the displays, sorted by priority, highest first */
+    DogLcdhw *panels[DOG_LCDbus_MAX_PANELS];
+    uint8_t priority[DOG_LCDbus_MAX_PANELS];
+    uint8_t count;
+    /** where the next poll() starts in a group of equal priority, kept
+     *  at the group's first display, so equal priorities take turns */
+    uint8_t turn[DOG_LCDbus_MAX_PANELS];
+};
+
+#endif
@@ -0,0 +1,86 @@
+/* dmf
+ * do_DogLcdGlyphs - any number of custom characters on a DogLcdhw
+ * See do_DogLcdGlyphs.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include "do_DogLcdGlyphs.h"
+
+DogLcdGlyphs::DogLcdGlyphs(DogLcdhw &lcd, uint8_t firstSlot, uint8_t slots) : lcd(lcd) {
+    if(firstSlot>7)
+        firstSlot=7;
+    if(slots<1 || firstSlot+slots>8)
+        slots=8-firstSlot;
+    this->firstSlot=firstSlot;
+    this->slots=slots;
+    glyphCount=0;
+    useClock=0;
+    invalidate();
+}
+
+int DogLcdGlyphs::add(const uint8_t bitmap[8]) {
+    if(glyphCount>=DOG_GLYPHS_MAX)
+        return -1;
+    glyphs[glyphCount]=bitmap;
+    return glyphCount++;
+}
+
+size_t DogLcdGlyphs::print(int handle) {
+    int slot=load(handle);
+    if(slot<0)
+        return 0;
+    slotUsed[slot]=++useClock;
+    return lcd.write((uint8_t)slot);
+}
+
+int DogLcdGlyphs::slotOf(int handle) {
+    for(int slot=firstSlot; slot<firstSlot+slots; slot++) {
+        if(slotGlyph[slot]==handle)
+            return slot;
+    }
+    return -1;
+}
+
+void DogLcdGlyphs::invalidate() {
+    for(int slot=0; slot<8; slot++) {
+        slotGlyph[slot]=-1;
+        slotUsed[slot]=0;
+    }
+}
+
+int DogLcdGlyphs::load(int handle) {
+    if(handle<0 || handle>=glyphCount)
+        return -1;
+    int slot=slotOf(handle);
+    if(slot>=0)
+        return slot;
+
+    // a miss - take a free slot, or else the least recently used one
+    // that no cell on the display (or in its shadow) refers to
+    int victim=-1;
+    for(slot=firstSlot; slot<firstSlot+slots; slot++) {
+        if(slotGlyph[slot]<0) {
+            victim=slot;
+            break;
+        }
+        // codes 8-15 show the same CGRAM slots as 0-7
+        if(lcd.countChar(slot)>0 || lcd.countChar(slot+8)>0)
+            continue;
+        // unsigned difference, so the age survives the clock wrapping
+        if(victim<0 || (uint16_t)(useClock-slotUsed[slot])>(uint16_t)(useClock-slotUsed[victim]))
+            victim=slot;
+    }
+    if(victim<0)
+        return -1;
+
+    lcd.loadGlyphs(victim,1,(const uint8_t (*)[8])glyphs[handle]);
+    slotGlyph[victim]=handle;
+    return victim;
+}
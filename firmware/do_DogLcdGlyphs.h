@@ -0,0 +1,100 @@
+/* dmf
+ * do_DogLcdGlyphs - any number of custom characters on a DogLcdhw
+ *
+ * The ST7036 only has 8 user-defined characters (CGRAM). DogLcdGlyphs
+ * keeps a registry of as many 5x8 glyphs as the application wants to
+ * use and maps them onto the CGRAM slots on demand: printing a glyph
+ * that is already loaded costs nothing extra, otherwise it is loaded
+ * into a free slot, or into the least recently used slot whose
+ * character is not on the display right now.
+ *
+ *   const uint8_t bell[8]={...};
+ *   DogLcdGlyphs glyphs(lcd);
+ *   int hBell=glyphs.add(bell);
+ *   lcd.setCursor(15,0);
+ *   glyphs.print(hBell);
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_GLYPHS_h
+#define do_DOG_LCD_GLYPHS_h
+
+#include "do_DogLcd.h"
+
+/** the number of glyphs that can be registered */
+#ifndef DOG_GLYPHS_MAX
+#define DOG_GLYPHS_MAX 32
+#endif
+
+static_assert(DOG_GLYPHS_MAX<=32767, "glyph handles are kept in 16 bits");
+
+class DogLcdGlyphs {
+ public:
+    /**
+     * Creates a glyph cache on a display.
+     * @param lcd the display, begin() must be called before printing
+     * @param firstSlot the first CGRAM slot (0..7) the cache may use
+     * @param slots the number of slots the cache may use, the others
+     * are left for createChar()
+     */
+    DogLcdGlyphs(DogLcdhw &lcd, uint8_t firstSlot=0, uint8_t slots=8);
+
+    /**
+     * Register a glyph.
+     * @param bitmap 8 rows of 5 bits, like for createChar(). Only the
+     * pointer is kept, the bitmap must stay around.
+     * @return the handle to print the glyph with, -1 if the registry
+     * is full
+     */
+    int add(const uint8_t bitmap[8]);
+
+    /**
+     * Print a glyph at the current cursor position, loading it into
+     * CGRAM if needed.
+     * @param handle the handle from add()
+     * @return 1 if the glyph was printed, 0 if the handle is invalid
+     * or all slots hold characters that are on the display
+     */
+    size_t print(int handle);
+
+    /**
+     * The character code (CGRAM slot) a glyph is loaded at, -1 if it is
+     * not loaded.
+     */
+    int slotOf(int handle);
+
+    /**
+     * Forget what is loaded, e.g. after a hardware reset of the display
+     * deleted the CGRAM
+     */
+    void invalidate();
+
+ private:
+    /**
+     * Find the slot for a glyph, loading it if it is not there
+     * @return the slot, -1 if no slot can be freed
+     */
+    int load(int handle);
+
+    DogLcdhw &lcd;
+    uint8_t firstSlot;
+    uint8_t slots;
+
+    /** the registered glyphs */
+    const uint8_t *glyphs[DOG_GLYPHS_MAX];
+    int glyphCount;
+
+    /** the glyph loaded in each slot (-1 for none) and when it was last used */
+    int16_t slotGlyph[8];
+    uint16_t slotUsed[8];
+    uint16_t useClock;
+};
+
+#endif
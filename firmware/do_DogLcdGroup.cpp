@@ -0,0 +1,265 @@
+/* dmf
+ * do_DogLcdGroup - several displays driven with the same bytes at once
+ * See do_DogLcdGroup.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include "do_DogLcdGroup.h"
+#include "do_DogLcd_hal.h"
+
+/* text is shared in pieces this long, with room left for the cursor
+ * commands that go with them */
+#define GROUP_CHUNK 16
+
+DogLcdGroup::DogLcdGroup() {
+    count=0;
+    buffer.data=data;
+    buffer.entry=entry;
+    buffer.size=DOG_LCDgroup_BUFFER;
+    buffer.length=0;
+}
+
+bool DogLcdGroup::add(DogLcdhw &lcd) {
+    if(count>=DOG_LCDgroup_MAX_PANELS)
+        return false;
+    // the bytes have to go out while the call is made
+    lcd.setAsync(false);
+    panels[count++]=&lcd;
+    return true;
+}
+
+int DogLcdGroup::begin(int model, int vcc, int contrast, int gain) {
+    // start all resets first, so their waits run side by side
+    for(int i=0; i<count; i++) {
+        if(panels[i]->configure(model,vcc,contrast,gain)!=0)
+            return -1;
+    }
+    reset();
+    return 0;
+}
+
+void DogLcdGroup::reset() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->startReset(false);
+    /* Step all displays through their waits together. They were started
+     * in order, so the first one is always the first to send its part
+     * of the initialization and the others can follow it.
+     */
+    while(true) {
+        unsigned long wait=0;
+        bool pending=false;
+        for(int i=0; i<count; i++) {
+            if(panels[i]->isReady())
+                continue;
+            unsigned long elapsed=dogMicros()-panels[i]->_initSince;
+            unsigned long remaining=(elapsed<panels[i]->_initFor) ? panels[i]->_initFor-elapsed : 0;
+            if(!pending || remaining<wait)
+                wait=remaining;
+            pending=true;
+        }
+        if(!pending)
+            break;
+        dogDelay(wait/1000);
+        dogDelayMicroseconds(wait%1000);
+#if defined(DOG_LCDhw_STATS)
+        for(int i=0; i<count; i++)
+            panels[i]->_stats.countBlocking(wait);
+#endif
+    }
+    finish();
+}
+
+void DogLcdGroup::setContrast(int contrast) {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->setContrast(contrast);
+    finish();
+}
+
+void DogLcdGroup::setGain(int gain) {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->setGain(gain);
+    finish();
+}
+
+void DogLcdGroup::createChar(int charCode, const uint8_t charMap[]) {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->createChar(charCode,charMap);
+    finish();
+}
+
+void DogLcdGroup::loadGlyphs(int firstSlot, int count, const uint8_t (*maps)[8]) {
+    // a char at a time, so the bytes fit into the buffer
+    for(int slot=0; slot<count; slot++) {
+        start();
+        for(int i=0; i<this->count; i++)
+            panels[i]->loadGlyphs(firstSlot+slot,1,maps+slot);
+        finish();
+    }
+}
+
+void DogLcdGroup::clear() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->clear();
+    finish();
+}
+
+void DogLcdGroup::home() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->home();
+    finish();
+}
+
+void DogLcdGroup::setCursor(int col, int row) {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->setCursor(col,row);
+    finish();
+}
+
+void DogLcdGroup::noDisplay() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->noDisplay();
+    finish();
+}
+
+void DogLcdGroup::display() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->display();
+    finish();
+}
+
+void DogLcdGroup::noBlink() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->noBlink();
+    finish();
+}
+
+void DogLcdGroup::blink() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->blink();
+    finish();
+}
+
+void DogLcdGroup::noCursor() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->noCursor();
+    finish();
+}
+
+void DogLcdGroup::cursor() {
+    start();
+    for(int i=0; i<count; i++)
+        panels[i]->cursor();
+    finish();
+}
+
+size_t DogLcdGroup::write(uint8_t c) {
+    return write(&c,1);
+}
+
+size_t DogLcdGroup::write(const uint8_t *chars, size_t size) {
+    for(size_t done=0; done<size; done+=GROUP_CHUNK) {
+        size_t n=size-done;
+        if(n>GROUP_CHUNK)
+            n=GROUP_CHUNK;
+        start();
+        for(int i=0; i<count; i++)
+            panels[i]->write(chars+done,n);
+        finish();
+    }
+    return size;
+}
+
+void DogLcdGroup::start() {
+    buffer.length=0;
+    for(int i=0; i<count; i++) {
+        captures[i].buffer=&buffer;
+        captures[i].leader=(i==0);
+        captures[i].matched=0;
+        captures[i].alone=false;
+        panels[i]->_capture=&captures[i];
+    }
+}
+
+void DogLcdGroup::finish() {
+    DogLcdhw *to[DOG_LCDgroup_MAX_PANELS];
+    int n=0;
+    for(int i=0; i<count; i++) {
+        DogLcdCapture &c=captures[i];
+        panels[i]->_capture=NULL;
+        // a display on its own way has sent everything itself
+        if(c.alone)
+            continue;
+        if(c.leader || c.matched==buffer.length) {
+            to[n++]=panels[i];
+        } else {
+            // it sends less than the first display
+            broadcast(&panels[i],1,c.matched);
+        }
+    }
+    if(n>0)
+        broadcast(to,n,buffer.length);
+}
+
+void DogLcdGroup::broadcast(DogLcdhw **to, int n, uint8_t count) {
+    // the bus runs at the clock of the slowest display
+    uint32_t clock=to[0]->_clockSpeed;
+    for(int k=1; k<n; k++) {
+        if(to[k]->_clockSpeed<clock)
+            clock=to[k]->_clockSpeed;
+    }
+    for(uint8_t i=0; i<count; i++) {
+        uint8_t value=data[i];
+        int rs=(entry[i] & 0x8000) ? HIGH : LOW;
+        // a DMA transfer of any display has the bus and CSB
+        while(!DogLcdhw::finishDma()) {
+            dogDelayMicroseconds(1);
+#if defined(DOG_LCDhw_STATS)
+            for(int k=0; k<n; k++)
+                to[k]->_stats.countBlocking(1);
+#endif
+        }
+        for(int k=0; k<n; k++) {
+            if(rs==HIGH)
+                dogFastPinHigh(to[k]->_fastRS);
+            else
+                dogFastPinLow(to[k]->_fastRS);
+            to[k]->waitReady();
+        }
+        if(to[0]->_hardware)
+            dogSpiBegin(clock,to[0]->_dataMode,to[0]->_bitOrder);
+        for(int k=0; k<n; k++)
+            dogFastPinLow(to[k]->_fastCSB);
+        // one transfer for all, they share the data and clock lines
+        to[0]->spiShift(value);
+        for(int k=0; k<n; k++)
+            dogFastPinHigh(to[k]->_fastCSB);
+        if(to[0]->_hardware)
+            dogSpiEnd();
+        for(int k=0; k<n; k++) {
+            to[k]->setBusy(entry[i] & 0x7FFF);
+#if defined(DOG_LCDhw_STATS)
+            to[k]->_stats.countByte(value,rs);
+            to[k]->_stats.countCsbEdges(2);
+#endif
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/* dmf
+ * do_DogLcdGroup - several displays driven with the same bytes at once
+ *
+ * The ST7036 only listens to the bus while its CSB is LOW and never
+ * answers, so with the CSB pins of several displays pulled LOW together
+ * one transfer reaches all of them. DogLcdGroup makes the calls that are
+ * the same for all its displays that way: the initialization (with the
+ * reset waits run side by side), contrast and gain, user-defined chars
+ * and text that every display shows, like a common header.
+ *
+ *   DogLcdhw lcd1(0, 0, 12, 11, 10), lcd2(0, 0, 9, 11, 10);
+ *   DogLcdGroup all;
+ *   all.add(lcd1);
+ *   all.add(lcd2);
+ *   all.begin(DOG_LCDhw_M162, DOG_LCDhw_VCC_3V3, -1, -1);
+ *   all.createChar(0, arrow_down);
+ *   all.print("== kiosk ==");
+ *   lcd2.setCursor(0, 1);        // content for one display goes to it
+ *   lcd2.print("display 2");
+ *
+ * A shared call is made on every display in turn, but the bytes of the
+ * first one are only collected and the others just check that they
+ * would send the same. At the end the bytes go out once, with the CSB
+ * pins of all displays that agree. A display that would send something
+ * else (because its cursor or mode was changed on its own, say) sends
+ * its own bytes, so the result is always the same as calling each
+ * display by itself.
+ *
+ * The displays must be on the hardware SPI, or share the SI and CLK
+ * pins of the software SPI. They are switched to synchronous mode.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_GROUP_h
+#define do_DOG_LCD_GROUP_h
+
+#include "do_DogLcd.h"
+
+/** the number of displays in a group */
+#ifndef DOG_LCDgroup_MAX_PANELS
+#define DOG_LCDgroup_MAX_PANELS 8
+#endif
+
+/** the number of bytes a shared call can send at once, longer text is
+ *  split, anything else that doesn't fit is sent to each display */
+#ifndef DOG_LCDgroup_BUFFER
+#define DOG_LCDgroup_BUFFER 40
+#endif
+
+class DogLcdGroup : public Print {
+ public:
+    DogLcdGroup();
+
+    /**
+     * Add a display to the group
+     * @return false if the group is full
+     */
+    bool add(DogLcdhw &lcd);
+
+    /**
+     * Initialize all displays, see DogLcdhw::begin(). The reset and
+     * power-up waits of all displays run at the same time.
+     * @return 0 if all displays were initialized, -1 otherwise.
+     */
+    int begin(int model, int vcc=DOG_LCDhw_VCC_3V3, int contrast=0, int gain=0);
+
+    /** reset all displays, see DogLcdhw::reset() */
+    void reset();
+
+    void setContrast(int contrast);
+    void setGain(int gain);
+
+    void createChar(int charCode, const uint8_t charMap[]);
+    void loadGlyphs(int firstSlot, int count, const uint8_t (*maps)[8]);
+
+    void clear();
+    void home();
+    void setCursor(int col, int row);
+
+    void noDisplay();
+    void display();
+    void noBlink();
+    void blink();
+    void noCursor();
+    void cursor();
+
+    using Print::write;
+
+    /** draw on all displays */
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+
+ private:
+    /**
+     * Start a shared call: the displays collect or compare their bytes
+     * from now on
+     */
+    void start();
+
+    /**
+     * Finish a shared call: send the collected bytes to every display
+     * that agrees with them
+     */
+    void finish();
+
+    /**
+     * Send the first count collected bytes to a number of displays at
+     * once
+     */
+    void broadcast(DogLcdhw **to, int n, uint8_t count);
+
+    DogLcdhw *panels[DOG_LCDgroup_MAX_PANELS];
+    DogLcdCapture captures[DOG_LCDgroup_MAX_PANELS];
+    uint8_t count;
+
+    uint8_t data[DOG_LCDgroup_BUFFER];
+    uint16_t entry[DOG_LCDgroup_BUFFER];
+    DogLcdCaptureBuffer buffer;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/* dmf
+ * do_DogLcdMarquee - tickers moved by the display shift of the ST7036
+ * See do_DogLcdMarquee.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include <string.h>
+#include "do_DogLcdMarquee.h"
+#include "do_DogLcd_hal.h"
+
+DogLcdMarquee::DogLcdMarquee(DogLcdhw &lcd) : lcd(lcd) {
+    for(int row=0; row<3; row++)
+        text[row]=NULL;
+    offset=0;
+    running=false;
+    stepMs=0;
+    steppedAt=0;
+}
+
+bool DogLcdMarquee::setText(int row, const char *text, int gap) {
+    if(row<0 || row>=lcd.getRows() || row>2)
+        return false;
+    if(text==NULL) {
+        this->text[row]=NULL;
+        return true;
+    }
+    int len=strlen(text);
+    int line=lcd.getLineLength();
+    if(gap<0)
+        gap=(len<=line) ? line-len : lcd.getColumns();
+    if(len>255 || gap>255 || len+gap<1)
+        return false;
+    this->text[row]=text;
+    length[row]=len;
+    this->gap[row]=gap;
+    bool buffered=startDrawing();
+    int shift=lcd.getDisplayShift();
+    if(shift!=(int)(offset%line)) {
+        // the display was shifted by something else (or was shifted
+        // before the first text), the texts start over from the cell
+        // that is in view now
+        if(shift<0) {
+            lcd.home();
+            shift=0;
+        }
+        offset=shift;
+        for(int r=0; r<3; r++) {
+            if(this->text[r]!=NULL)
+                fill(r);
+        }
+    } else {
+        fill(row);
+    }
+    endDrawing(buffered);
+    return true;
+}
+
+void DogLcdMarquee::fill(int row) {
+    int line=lcd.getLineLength();
+    /* Fill the line as it is laid out after the steps taken so far:
+     * the cell in view at the left edge shows the position 'offset',
+     * the cells before it come into view last.
+     */
+    for(int i=0; i<line; i++) {
+        int col=(offset+i)%line;
+        lcd.putChar(col,row,charAt(row,offset+i));
+    }
+}
+
+void DogLcdMarquee::start(uint16_t stepMs) {
+    this->stepMs=stepMs;
+    steppedAt=dogMillis();
+    running=true;
+}
+
+void DogLcdMarquee::stop(bool home) {
+    running=false;
+    if(!home)
+        return;
+    bool buffered=startDrawing();
+    lcd.home();
+    // the texts start over at the left edge
+    offset=0;
+    for(int row=0; row<3; row++) {
+        if(text[row]!=NULL)
+            fill(row);
+    }
+    endDrawing(buffered);
+}
+
+void DogLcdMarquee::step() {
+    int line=lcd.getLineLength();
+    bool buffered=startDrawing();
+    lcd.scrollDisplayLeft();
+    offset++;
+    /* The cell that just left the view on the left is the last one to
+     * come into view, a line's length of positions further on. It only
+     * has to be written when the text differs there, which it never
+     * does if the text and gap fill the line exactly.
+     */
+    int col=(offset-1)%line;
+    for(int row=0; row<3; row++) {
+        if(text[row]==NULL)
+            continue;
+        uint8_t next=charAt(row,offset-1+line);
+        if(next!=charAt(row,offset-1))
+            lcd.putChar(col,row,next);
+    }
+    endDrawing(buffered);
+}
+
+bool DogLcdMarquee::startDrawing() {
+    /* The cells are drawn into the display's shadow and go out with one
+     * flush(): putChar() on a direct display would send a cursor address
+     * for every cell, and another one to put a visible cursor back.
+     */
+    bool buffered=lcd.isBuffered();
+    if(!buffered)
+        lcd.setBuffered(true);
+    return buffered;
+}
+
+void DogLcdMarquee::endDrawing(bool buffered) {
+    // the shift went out at once, the streamed cells have to follow
+    if(buffered)
+        lcd.flush();
+    else
+        lcd.setBuffered(false);
+}
+
+void DogLcdMarquee::poll() {
+    if(!running)
+        return;
+    unsigned long now=dogMillis();
+    // unsigned difference, so this survives millis() wrapping
+    unsigned long late=now-steppedAt;
+    if(late<stepMs)
+        return;
+    // keep the pace, unless we are so late that catching up would
+    // only race through the text
+    if(late<2UL*stepMs)
+        steppedAt+=stepMs;
+    else
+        steppedAt=now;
+    step();
+}
+
+uint8_t DogLcdMarquee::charAt(int row, unsigned long pos) {
+    unsigned long n=pos%(length[row]+gap[row]);
+    return n<length[row] ? text[row][n] : ' ';
+}
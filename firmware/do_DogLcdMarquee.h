@@ -0,0 +1,113 @@
+/* dmf
+ * do_DogLcdMarquee - tickers moved by the display shift of the ST7036
+ *
+ * Each line of the display memory is longer than what is visible (40
+ * cells on a M162, 80 on a M081), and the display shift command that
+ * scrollDisplayLeft() sends moves the view over it without sending any
+ * characters. DogLcdMarquee writes the text of a ticker into the whole
+ * line once and then moves it one column per step with that single
+ * command. Text that does not fit into the line is streamed into the
+ * cell that just left the view on the left, which is the one that comes
+ * into view last, so every step costs one command plus at most one
+ * character per line.
+ *
+ *   DogLcdMarquee ticker(lcd);
+ *   ticker.setText(0,"+++ a news ticker that is longer than the line +++");
+ *   ticker.start(250);
+ *   ...
+ *   void loop() { ticker.poll(); }
+ *
+ * The display shift moves all lines together, so every line scrolls
+ * while the marquee runs. Lines without a text keep what they show and
+ * scroll along. The M163 has no cells beyond the visible 16, a text
+ * there is always streamed. The cells a call changes go out together
+ * with one flush(), also on a display drawn directly, and with buffered
+ * drawing every call flushes, since the shift itself is never buffered.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_MARQUEE_h
+#define do_DOG_LCD_MARQUEE_h
+
+#include "do_DogLcd.h"
+
+class DogLcdMarquee {
+ public:
+    /**
+     * Creates a marquee on a display.
+     * @param lcd the display, begin() must be called before setText()
+     */
+    DogLcdMarquee(DogLcdhw &lcd);
+
+    /**
+     * Set the text a line ticks through and write as much of it as fits
+     * into the line. The text repeats after a gap of blanks.
+     * @param row the line
+     * @param text the text, NULL to stop using the line. Only the pointer
+     * is kept, the text must stay around.
+     * @param gap the number of blanks between the end of the text and
+     * its next start. -1 (the default) fills up the line if the text
+     * fits into it, so the text is never written again, and otherwise
+     * leaves a visible line's width of blanks.
+     * @return false if the arguments are invalid
+     */
+    bool setText(int row, const char *text, int gap=-1);
+
+    /**
+     * Start moving, one column to the left every stepMs milliseconds
+     */
+    void start(uint16_t stepMs);
+
+    /**
+     * Stop moving. The display shift is taken back (with home()) if
+     * home is true.
+     */
+    void stop(bool home=true);
+
+    /**
+     * Move one column to the left now
+     */
+    void step();
+
+    /**
+     * Move if a step is due. Call this from loop().
+     */
+    void poll();
+
+ private:
+    /**
+     * Collect the cells drawn from now on in the display's shadow
+     * @return whether the display was buffered already
+     */
+    bool startDrawing();
+
+    /** send the collected cells, and go back to direct drawing if the
+     *  display was direct */
+    void endDrawing(bool buffered);
+
+    /** write the whole line of a row as it is laid out at 'offset' */
+    void fill(int row);
+
+    /** the character the text of a row has at a position of the ticker */
+    uint8_t charAt(int row, unsigned long pos);
+
+    DogLcdhw &lcd;
+
+    const char *text[3];
+    uint8_t length[3];
+    uint8_t gap[3];
+    /** the steps taken since the texts were set */
+    unsigned long offset;
+    bool running;
+    uint16_t stepMs;
+    unsigned long steppedAt;
+};
+
+#endif
@@ -0,0 +1,172 @@
+/* dmf
+ * do_DogLcdStats - counters and latency histograms for DogLcdhw
+ *
+ * Define DOG_LCDhw_STATS (for the whole build, e.g. -DDOG_LCDhw_STATS)
+ * to have every DogLcdhw count what it sends and how long its calls
+ * take. Without it the hooks below compile to nothing and DogLcdhw has
+ * no getStats()/resetStats().
+ *
+ *   const DogLcdStats &s=lcd.getStats();
+ *   Serial.println(s.dataBytes);
+ *   Serial.println(s.commands[DOG_OPCODE_ADDRESS]);
+ *   Serial.println(s.blockingMicros);
+ *   lcd.resetStats();
+ *
+ * The counters cover what the driver sends, by RS and by kind of
+ * command, the edges on CSB and the time spent in delay() and
+ * delayMicroseconds(). For each group of public calls a histogram
+ * counts how long the calls took, in powers of two of microseconds.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_STATS_h
+#define do_DOG_LCD_STATS_h
+
+#include <string.h>
+#include "do_DogLcd_hal.h"
+
+#if defined(DOG_LCDhw_STATS)
+
+/** the kinds of commands counted in DogLcdStats::commands */
+enum {
+    DOG_OPCODE_FUNCTION_SET,    // 0x20..0x3F, selects the instruction table
+    DOG_OPCODE_TABLE1,          // bias, power/contrast, follower (gain) in table 1
+    DOG_OPCODE_ADDRESS,         // set DDRAM or CGRAM address
+    DOG_OPCODE_CLEAR_HOME,      // clear display, return home
+    DOG_OPCODE_DISPLAY,         // display on/off control
+    DOG_OPCODE_ENTRY_MODE,      // entry mode set
+    DOG_OPCODE_SHIFT,           // cursor or display shift
+    DOG_OPCODE_OTHER,           // anything else, e.g. table 2
+    DOG_OPCODE_CLASSES
+};
+
+/** the groups of public calls timed in DogLcdStats::histogram */
+enum {
+    DOG_STAT_BEGIN,             // begin(), beginAsync()
+    DOG_STAT_RESET,             // reset()
+    DOG_STAT_CLEAR,             // clear()
+    DOG_STAT_HOME,              // home()
+    DOG_STAT_SET_CURSOR,        // setCursor()
+    DOG_STAT_WRITE,             // write(), print(), ascii(), putChar()
+    DOG_STAT_CREATE_CHAR,       // createChar(), loadGlyphs()
+    DOG_STAT_CONTRAST,          // setContrast(), setGain()
+    DOG_STAT_MODE,              // display, cursor, blink, entry mode and scrolling
+    DOG_STAT_FLUSH,             // flush()
+    DOG_STAT_PAGE,              // showPage(), flip()
+    DOG_STAT_POLL,              // poll()
+    DOG_STAT_METHODS
+};
+
+/** histogram bucket n counts calls taking 2^(n-1)..2^n-1 us, the
+ *  first those under 1us, the last everything from 16ms */
+#define DOG_STAT_BUCKETS 16
+
+struct DogLcdStats {
+    /** bytes sent with RS HIGH (data) and LOW (commands) */
+    uint32_t dataBytes;
+    uint32_t commandBytes;
+    /** commands, by DOG_OPCODE_... */
+    uint32_t commands[DOG_OPCODE_CLASSES];
+    /** level changes of CSB, two per transfer or burst */
+    uint32_t csbEdges;
+    /** the time the driver spent waiting in delay()/delayMicroseconds() */
+    uint32_t blockingMicros;
+    /** calls by DOG_STAT_... and duration, counts stop at 65535 */
+    uint16_t histogram[DOG_STAT_METHODS][DOG_STAT_BUCKETS];
+    /** the instruction table the counted commands selected last, to
+     *  tell the commands of table 0 and 1 apart */
+    uint8_t table;
+
+    void reset() {
+        memset(this,0,sizeof(*this));
+    }
+
+    void countByte(uint8_t value, int rs) {
+        if(rs==HIGH) {
+            dataBytes++;
+            return;
+        }
+        commandBytes++;
+        commands[opcodeClass(value)]++;
+        if((value & 0xE0)==0x20)
+            table=value & 0x03;
+    }
+
+    void countCsbEdges(uint8_t edges) {
+        csbEdges+=edges;
+    }
+
+    void countBlocking(unsigned long us) {
+        blockingMicros+=us;
+    }
+
+    void record(uint8_t method, unsigned long us) {
+        uint8_t bucket=0;
+        while(us>0 && bucket<DOG_STAT_BUCKETS-1) {
+            us>>=1;
+            bucket++;
+        }
+        if(histogram[method][bucket]<0xFFFF)
+            histogram[method][bucket]++;
+    }
+
+    uint8_t opcodeClass(uint8_t cmd) {
+        if(cmd & 0x80)
+            return DOG_OPCODE_ADDRESS;
+        if(cmd & 0x40) {
+            // CGRAM address in table 0, contrast and gain in table 1
+            if(table==0)
+                return DOG_OPCODE_ADDRESS;
+            return table==1 ? DOG_OPCODE_TABLE1 : DOG_OPCODE_OTHER;
+        }
+        if(cmd & 0x20)
+            return DOG_OPCODE_FUNCTION_SET;
+        if(cmd & 0x10) {
+            // shift in table 0, bias in table 1
+            if(table==0)
+                return DOG_OPCODE_SHIFT;
+            return table==1 ? DOG_OPCODE_TABLE1 : DOG_OPCODE_OTHER;
+        }
+        if(cmd & 0x08)
+            return DOG_OPCODE_DISPLAY;
+        if(cmd & 0x04)
+            return DOG_OPCODE_ENTRY_MODE;
+        if(cmd & 0x03)
+            return DOG_OPCODE_CLEAR_HOME;
+        return DOG_OPCODE_OTHER;
+    }
+};
+
+/**
+ * Times a call from its construction to the end of the scope
+ */
+class DogLcdStatScope {
+ public:
+    DogLcdStatScope(DogLcdStats &stats, uint8_t method)
+        : stats(stats), method(method), since(dogMicros()) {}
+    ~DogLcdStatScope() { stats.record(method,dogMicros()-since); }
+ private:
+    DogLcdStats &stats;
+    uint8_t method;
+    unsigned long since;
+};
+
+/* the hooks used inside DogLcdhw */
+#define DOG_STAT_SCOPE(method) DogLcdStatScope _statScope(_stats,method)
+#define DOG_STAT_COUNT(call) _stats.call
+
+#else
+
+#define DOG_STAT_SCOPE(method)
+#define DOG_STAT_COUNT(call)
+
+#endif
+
+#endif
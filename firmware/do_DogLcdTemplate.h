@@ -0,0 +1,348 @@
+/* dmf
+ * do_DogLcdTemplate - a compile-time specialized version of DogLcdhw
+ *
+ * DogLcdhw works out the model and supply voltage in begin() and checks
+ * for hardware or software SPI on every byte. When all of that is known
+ * when the code is compiled, DogLcd<Model, Vcc, Transport> does the same
+ * job with the geometry and settings taken from DogLcdModel/DogLcdSupply
+ * (do_DogLcd.h) as constants, and the transport called directly, so
+ * there is no dispatch left in the byte loop and an instance only keeps
+ * its pins and the controller state in RAM.
+ *
+ *   DogLcd<DOG_LCDhw_M162, DOG_LCDhw_VCC_3V3, DogLcdHardwareSpi<> > lcd(12, 11, 10);
+ *   DogLcd<DOG_LCDhw_M163, DOG_LCDhw_VCC_5V, DogLcdHardwareSpi<1000000> > lcd(8, 7);
+ *   DogLcd<DOG_LCDhw_M081, DOG_LCDhw_VCC_5V, DogLcdSoftwareSpi<11, 13> > lcd(10, 9);
+ *
+ * Cursor positions that are constants can be checked by the compiler:
+ *   lcd.setCursor<3, 1>();
+ *
+ * The shadow framebuffer of DogLcdhw is not available here.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_TEMPLATE_h
+#define do_DOG_LCD_TEMPLATE_h
+
+#include "do_DogLcd.h"
+#include "do_DogLcd_hal.h"
+
+/**
+ * Transport over the hardware SPI (MOSI, SCK).
+ * @param CLOCK the SPI clock in Hz, default DOG_LCDhw_SPI_CLOCK
+ * @param MODE the SPI mode, 0..3, default 3 as for DogLcdhw
+ */
+template <uint32_t CLOCK=DOG_LCDhw_SPI_CLOCK, int MODE=3> struct DogLcdHardwareSpi {
+    static void begin() {
+        SPI.begin();
+    }
+    /** take the bus while the display is selected, so other devices
+     *  can use settings of their own */
+    static void select() {
+        dogSpiBegin(CLOCK,MODE,MSBFIRST);
+    }
+    static void deselect() {
+        dogSpiEnd();
+    }
+    static void transfer(uint8_t value) {
+        dogSpiTransfer(value);
+    }
+};
+
+/**
+ * Transport that bit-bangs the data out on any two pins.
+ * @param SI the pin connected to the SI-pin on the display
+ * @param CLK the pin connected to the CLK-pin on the display
+ */
+template <int SI, int CLK> struct DogLcdSoftwareSpi {
+    static void begin() {
+        dogPinMode(SI,OUTPUT);
+        dogDigitalWrite(SI,HIGH);
+        dogPinMode(CLK,OUTPUT);
+        dogDigitalWrite(CLK,HIGH);
+        dogFastPinInit(si,SI);
+        dogFastPinInit(clk,CLK);
+    }
+    static void select() {
+    }
+    static void deselect() {
+    }
+    static void transfer(uint8_t value) {
+        // MSB first, the display samples SI on the rising edge of CLK
+        for(uint8_t mask=0x80; mask; mask>>=1) {
+            if(value & mask)
+                dogFastPinHigh(si);
+            else
+                dogFastPinLow(si);
+            dogFastPinLow(clk);
+            dogFastPinHigh(clk);
+        }
+    }
+    /** the pins, resolved by begin() */
+    static DogFastPin si;
+    static DogFastPin clk;
+};
+
+template <int SI, int CLK> DogFastPin DogLcdSoftwareSpi<SI,CLK>::si;
+template <int SI, int CLK> DogFastPin DogLcdSoftwareSpi<SI,CLK>::clk;
+
+template <int MODEL, int VCC, class Transport>
+class DogLcd : public Print {
+ public:
+    typedef DogLcdModel<MODEL> Model;
+    typedef DogLcdSupply<VCC> Supply;
+
+    /**
+     * Creates a new instance and assigns the pins used to control the
+     * display. The SI and CLK pins belong to the Transport.
+     * @param lcdCSB the pin connected to the CSB-pin on the display
+     * @param lcdRS the pin connected to the RS-pin on the display
+     * @param lcdRESET the pin connected to the RESET-pin, -1 if the
+     * RESET-pin is connected to VCC
+     */
+    DogLcd(int8_t lcdCSB, int8_t lcdRS, int8_t lcdRESET=-1)
+        : lcdCSB(lcdCSB), lcdRS(lcdRS), lcdRESET(lcdRESET) {}
+
+    /**
+     * Resets and initializes the display, see DogLcdhw::begin().
+     * @param contrast 0..63, -1 for the default of the supply voltage
+     * @param gain 0..7, -1 for the default of the supply voltage
+     * @return 0 if the display was sucessfully initialized,
+     * -1 otherwise.
+     */
+    int begin(int contrast=-1, int gain=-1) {
+        if(contrast==-1)
+            contrast=Supply::contrast;
+        if(gain==-1)
+            gain=Supply::gain;
+        if(contrast<0 || contrast>0x3F || gain<0 || gain>0x07)
+            return -1;
+        this->contrast=contrast;
+        this->gain=gain;
+
+        dogPinMode(lcdCSB,OUTPUT);
+        dogDigitalWrite(lcdCSB,HIGH);
+        dogPinMode(lcdRS,OUTPUT);
+        dogDigitalWrite(lcdRS,HIGH);
+        dogFastPinInit(fastCSB,lcdCSB);
+        dogFastPinInit(fastRS,lcdRS);
+        if(lcdRESET!=-1) {
+            dogPinMode(lcdRESET,OUTPUT);
+            dogDigitalWrite(lcdRESET,HIGH);
+        }
+        Transport::begin();
+        reset();
+        return 0;
+    }
+
+    /**
+     * Reset the display, see DogLcdhw::reset(). Created characters
+     * are lost if the RESET-pin is wired.
+     */
+    void reset() {
+        if(lcdRESET!=-1) {
+            dogDigitalWrite(lcdRESET,LOW);
+            dogDelay(40);
+            dogDigitalWrite(lcdRESET,HIGH);
+            dogDelay(40);
+        } else {
+            dogDelay(50);
+        }
+        table=0xFF;
+        displayControl=0x0C | 0x02;
+        entryMode=0x06;
+        setInstructionSet(1);
+        writeCommand(Model::biasAndFx | Supply::bias);
+        writeCommand(0x50 | Supply::boosterMode | ((contrast>>4) & 0x03));
+        writeCommand(0x70 | (contrast & 0x0F));
+        writeCommand(0x60 | 0x08 | gain);
+        writeCommand(displayControl);
+        writeCommand(entryMode);
+        writeCommand(0x01);
+    }
+
+    /** see DogLcdhw::setContrast() */
+    void setContrast(int contrast) {
+        if(contrast<0 || contrast>0x3F || contrast==this->contrast)
+            return;
+        setInstructionSet(1);
+        if((contrast>>4)!=(this->contrast>>4))
+            writeCommand(0x50 | Supply::boosterMode | ((contrast>>4) & 0x03));
+        if((contrast & 0x0F)!=(this->contrast & 0x0F))
+            writeCommand(0x70 | (contrast & 0x0F));
+        this->contrast=contrast;
+    }
+
+    /** see DogLcdhw::setGain() */
+    void setGain(int gain) {
+        if(gain<0 || gain>0x07 || gain==this->gain)
+            return;
+        setInstructionSet(1);
+        writeCommand(0x60 | 0x08 | gain);
+        this->gain=gain;
+    }
+
+    void clear() {
+        writeCommand(0x01);
+        // clear also sets the entry mode back to left-to-right
+        entryMode|=0x02;
+    }
+
+    void home() { writeCommand(0x02); }
+
+    void noDisplay() { setDisplayControl(displayControl & ~0x04); }
+    void display() { setDisplayControl(displayControl | 0x04); }
+    void noCursor() { setDisplayControl(displayControl & ~0x02); }
+    void cursor() { setDisplayControl(displayControl | 0x02); }
+    void noBlink() { setDisplayControl(displayControl & ~0x01); }
+    void blink() { setDisplayControl(displayControl | 0x01); }
+
+    void scrollDisplayLeft() {
+        setInstructionSet(0);
+        writeCommand(0x18);
+    }
+
+    void scrollDisplayRight() {
+        setInstructionSet(0);
+        writeCommand(0x1C);
+    }
+
+    void leftToRight() { setEntryMode(entryMode | 0x02); }
+    void rightToLeft() { setEntryMode(entryMode & ~0x02); }
+    void autoscroll() { setEntryMode(entryMode | 0x01); }
+    void noAutoscroll() { setEntryMode(entryMode & ~0x01); }
+
+    /** see DogLcdhw::createChar(), the cursor goes to the start of the first line */
+    void createChar(int charCode, const uint8_t charMap[]) {
+        if(charCode<0 || charCode>7)
+            return;
+        setInstructionSet(0);
+        writeCommand(0x40 | (charCode*8));
+        writeData(charMap,8);
+        // back to DDRAM, like DogLcdhw
+        writeCommand(0x80);
+    }
+
+    /**
+     * Set the cursor to a new location. Invalid locations are ignored.
+     */
+    void setCursor(int col, int row) {
+        if(col<0 || col>=Model::memSize || row<0 || row>=Model::rows)
+            return;
+        writeCommand(0x80 | ((Model::start(row)+col) & 0x7F));
+    }
+
+    /**
+     * Set the cursor to a location known at compile time, which is
+     * checked against the size of the model.
+     */
+    template <int COL, int ROW> void setCursor() {
+        static_assert(COL>=0 && COL<Model::memSize, "column outside the display memory");
+        static_assert(ROW>=0 && ROW<Model::rows, "row outside the display");
+        writeCommand(0x80 | ((Model::start(ROW)+COL) & 0x7F));
+    }
+
+    using Print::write;
+
+    virtual size_t write(uint8_t c) {
+        writeData(&c,1);
+        return 1;
+    }
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        writeData(buffer,size);
+        return size;
+    }
+
+    /**
+     * Send a run of data bytes in one burst, see DogLcdhw::writeData()
+     */
+    void writeData(const uint8_t *data, size_t len) {
+        if(len==0)
+            return;
+        dogFastPinHigh(fastRS);
+        waitReady();
+        Transport::select();
+        dogFastPinLow(fastCSB);
+        for(size_t i=0; i<len; i++) {
+            if(i>0)
+                waitReady();
+            Transport::transfer(data[i]);
+            setBusy(dogExecutionMicros(DOG_LCDhw_CLOCKS_SHORT,DOG_LCDhw_FOSC,DOG_LCDhw_TIMING_MARGIN));
+        }
+        dogFastPinHigh(fastCSB);
+        Transport::deselect();
+    }
+
+ private:
+    void setInstructionSet(uint8_t is) {
+        if(is==table)
+            return;
+        writeCommand(Model::functionSet | is);
+        table=is;
+    }
+
+    void setDisplayControl(uint8_t cmd) {
+        if(cmd==displayControl)
+            return;
+        writeCommand(cmd);
+        displayControl=cmd;
+    }
+
+    void setEntryMode(uint8_t cmd) {
+        if(cmd==entryMode)
+            return;
+        writeCommand(cmd);
+        entryMode=cmd;
+    }
+
+    /* the execution time is a constant for a constant command */
+    void writeCommand(uint8_t cmd) {
+        unsigned int executionTime=dogExecutionMicros(dogInstructionClocks(cmd),
+                                                      DOG_LCDhw_FOSC,DOG_LCDhw_TIMING_MARGIN);
+        dogFastPinLow(fastRS);
+        waitReady();
+        Transport::select();
+        dogFastPinLow(fastCSB);
+        Transport::transfer(cmd);
+        dogFastPinHigh(fastCSB);
+        Transport::deselect();
+        setBusy(executionTime);
+    }
+
+    /* deadline based busy tracking, see DogLcdhw::waitReady() */
+    void setBusy(unsigned int executionTime) {
+        busySince=dogMicros();
+        busyFor=executionTime;
+    }
+
+    void waitReady() {
+        unsigned long elapsed=dogMicros()-busySince;
+        if(elapsed<busyFor)
+            dogDelayMicroseconds(busyFor-elapsed);
+        busyFor=0;
+    }
+
+    int8_t lcdCSB;
+    int8_t lcdRS;
+    int8_t lcdRESET;
+    /** CSB and RS, resolved by begin() */
+    DogFastPin fastCSB;
+    DogFastPin fastRS;
+    uint8_t contrast=0;
+    uint8_t gain=0;
+    /** what the controller was last told, 0xFF if unknown */
+    uint8_t table=0xFF;
+    uint8_t displayControl=0x0E;
+    uint8_t entryMode=0x06;
+    unsigned long busySince=0;
+    uint16_t busyFor=0;
+};
+
+#endif
@@ -0,0 +1,139 @@
+/* dmf
+ * do_DogLcdTrace - event tracing of DogLcdhw in Chrome trace format
+ * See do_DogLcdTrace.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include <string.h>
+#include "do_DogLcdTrace.h"
+
+#if defined(DOG_LCDhw_TRACE)
+
+#if !defined(SPARK) && !defined(ARDUINO)
+#include <stdio.h>
+#endif
+
+DogLcdTraceEvent DogLcdTrace::events[DOG_LCDhw_TRACE_SIZE];
+unsigned long DogLcdTrace::head=0;
+uint8_t DogLcdTrace::tracks=0;
+
+/* the depth of the spans open per track while dumping, tracks beyond
+ * this share a counter */
+#define TRACE_TRACKS 16
+
+void DogLcdTrace::record(uint8_t track, const char *name, char phase, int16_t value) {
+    // calls from loop() and from a timer interrupt share the buffer
+    dogIrqState state=dogEnterCritical();
+    DogLcdTraceEvent &event=events[head % DOG_LCDhw_TRACE_SIZE];
+    event.micros=dogMicros();
+    event.name=name;
+    event.value=value;
+    event.phase=phase;
+    event.track=track;
+    head++;
+    dogExitCritical(state);
+}
+
+void DogLcdTrace::clear() {
+    dogIrqState state=dogEnterCritical();
+    head=0;
+    dogExitCritical(state);
+}
+
+int DogLcdTrace::count() {
+    return head<DOG_LCDhw_TRACE_SIZE ? head : DOG_LCDhw_TRACE_SIZE;
+}
+
+uint8_t DogLcdTrace::newTrack() {
+    return ++tracks;
+}
+
+void DogLcdTrace::printName(Print &out, const char *name) {
+    // a JSON string, names of the application may hold anything
+    for(; *name!=0; name++) {
+        uint8_t c=*name;
+        if(c=='"' || c=='\\') {
+            out.print('\\');
+            out.print((char)c);
+        } else if(c<0x20) {
+            out.print("\\u00");
+            out.print((char)("0123456789abcdef"[c>>4]));
+            out.print((char)("0123456789abcdef"[c & 0x0F]));
+        } else {
+            out.print((char)c);
+        }
+    }
+}
+
+void DogLcdTrace::dump(Print &out) {
+    dogIrqState state=dogEnterCritical();
+    unsigned long last=head;
+    dogExitCritical(state);
+    unsigned long first=last-count();
+    uint8_t depth[TRACE_TRACKS];
+    memset(depth,0,sizeof(depth));
+    bool comma=false;
+    out.print("{\"traceEvents\":[");
+    for(unsigned long n=first; n<last; n++) {
+        const DogLcdTraceEvent &event=events[n % DOG_LCDhw_TRACE_SIZE];
+        uint8_t &open=depth[event.track % TRACE_TRACKS];
+        if(event.phase=='E') {
+            // its begin was overwritten
+            if(open==0)
+                continue;
+            open--;
+        } else {
+            open++;
+        }
+        if(comma)
+            out.print(",");
+        comma=true;
+        out.print("\n{\"name\":\"");
+        printName(out,event.name);
+        out.print("\",\"ph\":\"");
+        out.print(event.phase);
+        out.print("\",\"ts\":");
+        out.print(event.micros);
+        out.print(",\"pid\":1,\"tid\":");
+        out.print((int)event.track);
+        if(event.value>=0) {
+            out.print(",\"args\":{\"byte\":");
+            out.print((int)event.value);
+            out.print("}");
+        }
+        out.print("}");
+    }
+    out.print("\n]}\n");
+}
+
+#if !defined(SPARK) && !defined(ARDUINO)
+
+namespace {
+    class FilePrint : public Print {
+     public:
+        FilePrint(FILE *file) : file(file) {}
+        virtual size_t write(uint8_t c) { return fputc(c,file)==EOF ? 0 : 1; }
+     private:
+        FILE *file;
+    };
+}
+
+bool DogLcdTrace::save(const char *path) {
+    FILE *file=fopen(path,"w");
+    if(file==NULL)
+        return false;
+    FilePrint out(file);
+    dump(out);
+    return fclose(file)==0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/* dmf
+ * do_DogLcdTrace - event tracing of DogLcdhw in Chrome trace format
+ *
+ * Define DOG_LCDhw_TRACE (for the whole build, e.g. -DDOG_LCDhw_TRACE)
+ * and compile do_DogLcdTrace.cpp to have every public call of DogLcdhw,
+ * and every command, character and SPI transfer it sends, recorded as
+ * a begin and an end event with a micros() timestamp. The events go
+ * into a ring buffer of DOG_LCDhw_TRACE_SIZE entries that keeps the
+ * most recent ones. Without the define the hooks compile to nothing.
+ *
+ * dump() writes the buffer as Chrome trace JSON to any Print, e.g.
+ * Serial on the target, to be loaded into Perfetto (ui.perfetto.dev)
+ * or chrome://tracing. On the host save() writes it to a file instead.
+ * Each display gets its own track, the application can add spans of
+ * its own on track 0:
+ *
+ *   DogLcdTrace::begin("update");
+ *   lcd.print(value);
+ *   DogLcdTrace::end("update");
+ *   ...
+ *   DogLcdTrace::dump(Serial);
+ *
+ * Names are kept as pointers, they must be string literals or
+ * otherwise stay around.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_TRACE_h
+#define do_DOG_LCD_TRACE_h
+
+#include "do_DogLcd_hal.h"
+
+#if defined(DOG_LCDhw_TRACE)
+
+/** number of events the ring buffer holds */
+#ifndef DOG_LCDhw_TRACE_SIZE
+#if defined(__AVR__)
+#define DOG_LCDhw_TRACE_SIZE 32
+#else
+#define DOG_LCDhw_TRACE_SIZE 256
+#endif
+#endif
+
+struct DogLcdTraceEvent {
+    unsigned long micros;
+    const char *name;
+    /** the byte sent, -1 for none */
+    int16_t value;
+    /** 'B' for begin, 'E' for end */
+    char phase;
+    /** the track, 0 for the application, 1.. for the displays */
+    uint8_t track;
+};
+
+class DogLcdTrace {
+ public:
+    /** start a span of the application */
+    static void begin(const char *name) { record(0,name,'B',-1); }
+    /** end a span of the application */
+    static void end(const char *name) { record(0,name,'E',-1); }
+
+    /** forget all events */
+    static void clear();
+
+    /** the number of events held, at most DOG_LCDhw_TRACE_SIZE */
+    static int count();
+
+    /**
+     * Write the events as Chrome trace JSON. End events whose begin has
+     * already been overwritten are left out.
+     */
+    static void dump(Print &out);
+
+#if !defined(SPARK) && !defined(ARDUINO)
+    /**
+     * Write the events as Chrome trace JSON to a file
+     * @return false if the file can't be written
+     */
+    static bool save(const char *path);
+#endif
+
+    /** a new track for a display */
+    static uint8_t newTrack();
+
+    static void record(uint8_t track, const char *name, char phase, int16_t value);
+
+ private:
+    /** write a name as the inside of a JSON string */
+    static void printName(Print &out, const char *name);
+
+    static DogLcdTraceEvent events[DOG_LCDhw_TRACE_SIZE];
+    /** the total number of events recorded, the next goes to head % size */
+    static unsigned long head;
+    static uint8_t tracks;
+};
+
+/**
+ * Records a begin event when constructed and the end event when the
+ * scope is left
+ */
+class DogLcdTraceScope {
+ public:
+    DogLcdTraceScope(uint8_t track, const char *name, int16_t value=-1)
+        : track(track), name(name), value(value) {
+        DogLcdTrace::record(track,name,'B',value);
+    }
+    ~DogLcdTraceScope() { DogLcdTrace::record(track,name,'E',value); }
+ private:
+    uint8_t track;
+    const char *name;
+    int16_t value;
+};
+
+/* the hooks used inside DogLcdhw */
+#define DOG_TRACE_SCOPE(name) DogLcdTraceScope _traceScope(_traceTrack,name)
+#define DOG_TRACE_SCOPE_BYTE(name,value) DogLcdTraceScope _traceScope(_traceTrack,name,value)
+
+#else
+
+#define DOG_TRACE_SCOPE(name)
+#define DOG_TRACE_SCOPE_BYTE(name,value)
+
+#endif
+
+#endif
@@ -0,0 +1,304 @@
+/* dmf
+ * do_DogLcd_hal - the thin hardware abstraction used by do_DogLcd.
+ *
+ * The driver never calls pinMode()/digitalWrite()/SPI/delay directly but
+ * goes through the inline functions below. On the Particle Core/Photon
+ * and on Arduino they map straight onto the platform calls, so there is
+ * no cost on target. Anywhere else (e.g. a Linux host) the library is
+ * built against the host backend in /host, which runs a software model
+ * of the ST7036 controller on a virtual clock.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_DOG_LCD_HAL_h
+#define do_DOG_LCD_HAL_h
+
+#if defined(SPARK)
+#include <application.h>
+#elif defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#include <SPI.h>
+#elif defined(ARDUINO)
+#include <WProgram.h>
+#include <SPI.h>
+#else
+// neither Particle nor Arduino - use the host backend
+#include "hal_host.h"
+#endif
+
+static inline void dogPinMode(int pin, int mode) {
+    pinMode(pin, mode);
+}
+
+static inline void dogDigitalWrite(int pin, int value) {
+    digitalWrite(pin, value);
+}
+
+static inline uint8_t dogSpiTransfer(uint8_t value) {
+    return SPI.transfer(value);
+}
+
+/*
+ * Ownership of the hardware SPI. dogSpiBegin() takes the bus with the
+ * clock (in Hz), mode (0..3) and bit order of the display and
+ * dogSpiEnd() gives it back, so other devices on the bus can run with
+ * settings of their own. Where the SPI library has transactions they
+ * are used, elsewhere dogSpiBegin() applies the settings itself.
+ */
+static inline uint8_t dogSpiMode(int mode) {
+    switch(mode) {
+        case 0: return SPI_MODE0;
+        case 1: return SPI_MODE1;
+        case 2: return SPI_MODE2;
+        default: return SPI_MODE3;
+    }
+}
+
+#if defined(SPI_HAS_TRANSACTION)
+
+static inline void dogSpiBegin(uint32_t clock, int mode, uint8_t bitOrder) {
+    SPI.beginTransaction(SPISettings(clock,bitOrder,dogSpiMode(mode)));
+}
+
+static inline void dogSpiEnd() {
+    SPI.endTransaction();
+}
+
+#else
+
+// the clock the SPI dividers apply to
+#if defined(SPARK)
+#define DOG_SPI_BASE_CLOCK 72000000UL
+#else
+#define DOG_SPI_BASE_CLOCK F_CPU
+#endif
+
+static inline void dogSpiBegin(uint32_t clock, int mode, uint8_t bitOrder) {
+    static const uint8_t dividers[]={SPI_CLOCK_DIV2,SPI_CLOCK_DIV4,SPI_CLOCK_DIV8,
+        SPI_CLOCK_DIV16,SPI_CLOCK_DIV32,SPI_CLOCK_DIV64,SPI_CLOCK_DIV128};
+    // the fastest divider that doesn't go above the clock asked for
+    uint8_t i=0;
+    uint32_t hz=DOG_SPI_BASE_CLOCK/2;
+    while(i<sizeof(dividers)-1 && hz>clock) {
+        hz/=2;
+        i++;
+    }
+    SPI.setBitOrder(bitOrder);
+    SPI.setDataMode(dogSpiMode(mode));
+    SPI.setClockDivider(dividers[i]);
+}
+
+static inline void dogSpiEnd() {
+}
+
+#endif
+
+/* the SPI library can send a buffer in the background: the Photon, P1
+ * and Electron, and the host. The paced clock is only kept through
+ * SPI transactions, the divider fallback of dogSpiBegin() works from
+ * another base clock and stops at DIV128, so without them the bursts
+ * would go out too fast. */
+#if !defined(DOG_LCDhw_NO_DMA) && defined(SPI_HAS_TRANSACTION) && \
+    ((defined(SPARK) && defined(PLATFORM_ID) && PLATFORM_ID>=6) || \
+     (!defined(SPARK) && !defined(ARDUINO)))
+#define DOG_LCDhw_DMA
+#endif
+
+#if defined(DOG_LCDhw_DMA)
+/*
+ * Background transfers for the clock-paced bursts (see
+ * DogLcdhw::setPacedDma()). dogSpiDma() sends len bytes from tx at the
+ * clock of the current transaction and calls done() from the
+ * completion interrupt. dogSpiPacedClock() is the fastest clock the
+ * SPI can make that doesn't go above maxHz, 0 if it can't go that low.
+ */
+#if defined(SPARK)
+// the SPI of the Photon runs from the 60MHz APB2 clock
+#define DOG_SPI_DMA_BASE_CLOCK 60000000UL
+#else
+#define DOG_SPI_DMA_BASE_CLOCK HostHal::cpuHz
+#endif
+
+static inline void dogSpiDma(const uint8_t *tx, size_t len, void (*done)(void)) {
+    SPI.transfer((void*)tx,NULL,len,done);
+}
+
+static inline uint32_t dogSpiPacedClock(uint32_t maxHz) {
+    // dividers 2 to 256
+    for(uint8_t shift=1; shift<=8; shift++) {
+        uint32_t hz=DOG_SPI_DMA_BASE_CLOCK>>shift;
+        if(hz<=maxHz)
+            return hz;
+    }
+    return 0;
+}
+#endif
+
+static inline void dogDelay(unsigned long ms) {
+    delay(ms);
+}
+
+static inline void dogDelayMicroseconds(unsigned int us) {
+    delayMicroseconds(us);
+}
+
+static inline unsigned long dogMicros() {
+    return micros();
+}
+
+static inline unsigned long dogMillis() {
+    return millis();
+}
+
+/*
+ * Critical sections around state shared with an interrupt handler.
+ * dogEnterCritical() blocks interrupts and returns what is needed to
+ * restore the previous state, so it can be used inside handlers too.
+ */
+#if defined(ARDUINO) && defined(__AVR__)
+
+typedef uint8_t dogIrqState;
+
+static inline dogIrqState dogEnterCritical() {
+    uint8_t oldSREG=SREG;
+    cli();
+    return oldSREG;
+}
+
+static inline void dogExitCritical(dogIrqState state) {
+    SREG=state;
+}
+
+#elif defined(SPARK) || defined(ARDUINO)
+
+typedef uint8_t dogIrqState;
+
+static inline dogIrqState dogEnterCritical() {
+    noInterrupts();
+    return 0;
+}
+
+static inline void dogExitCritical(dogIrqState state) {
+    (void)state;
+    interrupts();
+}
+
+#else
+
+// the host's timer runs on a thread, the HAL lock keeps it out
+typedef uint8_t dogIrqState;
+
+static inline dogIrqState dogEnterCritical() {
+    HostHal::lock();
+    return 0;
+}
+
+static inline void dogExitCritical(dogIrqState state) {
+    (void)state;
+    HostHal::unlock();
+}
+
+#endif
+
+/*
+ * Fast pin access for the software SPI and the CSB/RS lines. A pin is
+ * resolved once with dogFastPinInit() (to its port register and bit
+ * mask where the platform allows it), after which dogFastPinHigh() and
+ * dogFastPinLow() are a single register write instead of digitalWrite()
+ * with its pin lookups and checks. The pin must already be an OUTPUT.
+ */
+#if defined(SPARK)
+
+// pinSetFast()/pinResetFast() write the GPIO set/reset register directly
+struct DogFastPin {
+    uint16_t pin;
+};
+
+static inline void dogFastPinInit(DogFastPin &p, int pin) {
+    p.pin=pin;
+}
+
+static inline void dogFastPinHigh(const DogFastPin &p) {
+    pinSetFast(p.pin);
+}
+
+static inline void dogFastPinLow(const DogFastPin &p) {
+    pinResetFast(p.pin);
+}
+
+#elif defined(ARDUINO) && defined(__AVR__)
+
+struct DogFastPin {
+    volatile uint8_t *port;
+    uint8_t mask;
+};
+
+static inline void dogFastPinInit(DogFastPin &p, int pin) {
+    p.port=portOutputRegister(digitalPinToPort(pin));
+    p.mask=digitalPinToBitMask(pin);
+}
+
+// read-modify-write on the port, so keep interrupt handlers that
+// touch other pins of the same port out, like digitalWrite() does
+static inline void dogFastPinHigh(const DogFastPin &p) {
+    uint8_t oldSREG=SREG;
+    cli();
+    *p.port|=p.mask;
+    SREG=oldSREG;
+}
+
+static inline void dogFastPinLow(const DogFastPin &p) {
+    uint8_t oldSREG=SREG;
+    cli();
+    *p.port&=~p.mask;
+    SREG=oldSREG;
+}
+
+#elif defined(ARDUINO)
+
+// no portable fast path on other Arduino cores
+struct DogFastPin {
+    uint8_t pin;
+};
+
+static inline void dogFastPinInit(DogFastPin &p, int pin) {
+    p.pin=pin;
+}
+
+static inline void dogFastPinHigh(const DogFastPin &p) {
+    digitalWrite(p.pin,HIGH);
+}
+
+static inline void dogFastPinLow(const DogFastPin &p) {
+    digitalWrite(p.pin,LOW);
+}
+
+#else
+
+// host backend, counted and timed separately from digitalWrite()
+struct DogFastPin {
+    int pin;
+};
+
+static inline void dogFastPinInit(DogFastPin &p, int pin) {
+    p.pin=pin;
+}
+
+static inline void dogFastPinHigh(const DogFastPin &p) {
+    pinWriteFast(p.pin,HIGH);
+}
+
+static inline void dogFastPinLow(const DogFastPin &p) {
+    pinWriteFast(p.pin,LOW);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,325 @@
+/* dmf
+ * hal_host - a Linux backend for do_DogLcd_hal.h
+ * See hal_host.h
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include "hal_host.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+SPIClass SPI;
+
+namespace HostHal {
+
+    uint32_t pinWriteNs=500;
+    uint32_t fastPinWriteNs=30;
+    uint32_t cpuHz=72000000UL;
+
+    static uint64_t now=0;
+    static uint64_t statsStart=0;
+    static Stats counters;
+    static uint8_t levels[HOST_PINS];
+    static HostDevice* devices[HOST_MAX_DEVICES];
+    static int clockDivider=SPI_CLOCK_DIV4;
+
+    /** the background transfer of SPIClass::transfer(tx, rx, len, callback) */
+    static struct {
+        uint8_t data[256];
+        size_t length;
+        size_t sent;
+        uint64_t startNs;
+        uint64_t byteNs;
+        void (*done)(void);
+    } dma;
+
+    static std::recursive_mutex halLock;
+    static std::thread timerThread;
+    static std::atomic<bool> timerRunning(false);
+
+    // everything the program can call goes through the lock
+    typedef std::lock_guard<std::recursive_mutex> Guard;
+
+    void lock() {
+        halLock.lock();
+    }
+
+    void unlock() {
+        halLock.unlock();
+    }
+
+    static void deliver(uint8_t value) {
+        counters.spiBytes++;
+        for(int i=0; i<HOST_MAX_DEVICES; i++) {
+            if(devices[i]!=NULL)
+                devices[i]->spiByte(value);
+        }
+    }
+
+    /* Move the virtual clock on. The bytes of a DMA transfer that are
+     * complete by then reach the devices, each at the time it completes,
+     * and the callback runs once the last one has, like the completion
+     * interrupt would.
+     */
+    static void advance(uint64_t ns) {
+        uint64_t target=now+ns;
+        while(dma.done!=NULL && dma.sent<dma.length
+              && dma.startNs+(dma.sent+1)*dma.byteNs<=target) {
+            now=dma.startNs+(dma.sent+1)*dma.byteNs;
+            deliver(dma.data[dma.sent++]);
+            if(dma.sent==dma.length) {
+                void (*done)(void)=dma.done;
+                dma.done=NULL;
+                done();
+            }
+        }
+        now=target;
+    }
+
+    static void startDma(const uint8_t* tx, size_t length, void (*done)(void)) {
+        Guard guard(halLock);
+        // finish a transfer still running first, as the hardware would
+        while(dma.done!=NULL)
+            advance(dma.byteNs);
+        if(length>sizeof(dma.data))
+            length=sizeof(dma.data);
+        memcpy(dma.data,tx,length);
+        dma.length=length;
+        dma.sent=0;
+        dma.startNs=now;
+        dma.byteNs=(uint64_t)8*clockDivider*1000000000ULL/cpuHz;
+        dma.done=done;
+        counters.dmaTransfers++;
+    }
+
+    void startTimer(void (*callback)(void*), void* arg, uint32_t periodUs) {
+        stopTimer();
+        timerRunning=true;
+        timerThread=std::thread([=]() {
+            while(timerRunning) {
+                std::this_thread::sleep_for(std::chrono::microseconds(periodUs));
+                Guard guard(halLock);
+                advance((uint64_t)periodUs*1000ULL);
+                callback(arg);
+            }
+        });
+    }
+
+    void stopTimer() {
+        timerRunning=false;
+        if(timerThread.joinable())
+            timerThread.join();
+    }
+
+    uint64_t nowNs() {
+        Guard guard(halLock);
+        return now;
+    }
+
+    void advanceNs(uint64_t ns) {
+        Guard guard(halLock);
+        advance(ns);
+    }
+
+    const Stats& stats() {
+        Guard guard(halLock);
+        counters.elapsedNs=now-statsStart;
+        return counters;
+    }
+
+    void resetStats() {
+        Guard guard(halLock);
+        memset(&counters, 0, sizeof(counters));
+        statsStart=now;
+    }
+
+    int pin(int pin) {
+        if(pin<0 || pin>=HOST_PINS)
+            return LOW;
+        return levels[pin];
+    }
+
+    bool attach(HostDevice* device) {
+        Guard guard(halLock);
+        for(int i=0; i<HOST_MAX_DEVICES; i++) {
+            if(devices[i]==NULL) {
+                devices[i]=device;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void detach(HostDevice* device) {
+        Guard guard(halLock);
+        for(int i=0; i<HOST_MAX_DEVICES; i++) {
+            if(devices[i]==device)
+                devices[i]=NULL;
+        }
+    }
+
+    static void setClockDivider(int divider) {
+        Guard guard(halLock);
+        clockDivider=divider;
+    }
+
+    static void beginTransaction(const SPISettings &settings) {
+        Guard guard(halLock);
+        int divider=SPI_CLOCK_DIV2;
+        while(divider<SPI_CLOCK_DIV256 && cpuHz/divider>settings.clock)
+            divider*=2;
+        clockDivider=divider;
+        counters.spiTransactions++;
+    }
+
+    static uint8_t transfer(uint8_t value) {
+        Guard guard(halLock);
+        // eight clock periods of the divided CPU clock
+        advance((uint64_t)8*clockDivider*1000000000ULL/cpuHz);
+        deliver(value);
+        // the ST7036 is write-only, nothing ever comes back
+        return 0;
+    }
+
+    static void write(int pin, int value, bool fast) {
+        Guard guard(halLock);
+        if(fast) {
+            advance(fastPinWriteNs);
+            counters.fastPinWrites++;
+        } else {
+            advance(pinWriteNs);
+            counters.pinWrites++;
+        }
+        if(pin<0 || pin>=HOST_PINS)
+            return;
+        value=value ? HIGH : LOW;
+        if(levels[pin]==value)
+            return;
+        levels[pin]=value;
+        counters.pinEdges[pin]++;
+        for(int i=0; i<HOST_MAX_DEVICES; i++) {
+            if(devices[i]!=NULL)
+                devices[i]->pinChanged(pin, value);
+        }
+    }
+
+    static void wait(uint64_t ns) {
+        Guard guard(halLock);
+        advance(ns);
+        counters.delayNs+=ns;
+    }
+}
+
+void pinMode(int pin, int mode) {
+    // pins are always usable on the host
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(int pin, int value) {
+    HostHal::write(pin, value, false);
+}
+
+void pinWriteFast(int pin, int value) {
+    HostHal::write(pin, value, true);
+}
+
+int digitalRead(int pin) {
+    return HostHal::pin(pin);
+}
+
+void analogWrite(int pin, int value) {
+    HostHal::write(pin, value>0 ? HIGH : LOW, false);
+}
+
+void delay(unsigned long ms) {
+    HostHal::wait((uint64_t)ms*1000000ULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+    HostHal::wait((uint64_t)us*1000ULL);
+}
+
+unsigned long micros() {
+    return (unsigned long)(HostHal::nowNs()/1000ULL);
+}
+
+unsigned long millis() {
+    return (unsigned long)(HostHal::nowNs()/1000000ULL);
+}
+
+void SPIClass::begin() {
+}
+
+void SPIClass::end() {
+}
+
+void SPIClass::setBitOrder(uint8_t bitOrder) {
+    // the simulator only understands MSBFIRST, like the ST7036
+    (void)bitOrder;
+}
+
+void SPIClass::setDataMode(uint8_t mode) {
+    (void)mode;
+}
+
+void SPIClass::setClockDivider(int divider) {
+    HostHal::setClockDivider(divider);
+}
+
+void SPIClass::beginTransaction(const SPISettings &settings) {
+    HostHal::beginTransaction(settings);
+}
+
+void SPIClass::endTransaction() {
+}
+
+uint8_t SPIClass::transfer(uint8_t value) {
+    return HostHal::transfer(value);
+}
+
+void SPIClass::transfer(void* tx, void* rx, size_t length, void (*callback)(void)) {
+    // nothing comes back from the ST7036, rx stays as it is
+    (void)rx;
+    HostHal::startDma((const uint8_t*)tx,length,callback);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n=0;
+    while(size--)
+        n+=write(*buffer++);
+    return n;
+}
+
+size_t Print::print(long n, int base) {
+    if(n<0 && base==DEC) {
+        size_t t=print('-');
+        return t+printNumber((unsigned long)-n, base);
+    }
+    return printNumber((unsigned long)n, base);
+}
+
+size_t Print::printNumber(unsigned long n, int base) {
+    char buf[8*sizeof(long)+1];
+    char* str=&buf[sizeof(buf)-1];
+    *str='\0';
+    if(base<2)
+        base=10;
+    do {
+        unsigned long m=n;
+        n/=base;
+        char c=m-base*n;
+        *--str=c<10 ? c+'0' : c+'A'-10;
+    } while(n);
+    return write(str);
+}
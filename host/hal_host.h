@@ -0,0 +1,227 @@
+/* dmf
+ * hal_host - a Linux backend for do_DogLcd_hal.h
+ *
+ * Provides just enough of the Arduino/Particle API (pins, SPI, delays,
+ * Print) for do_DogLcd to build and run on a host. Nothing real is
+ * driven: pin changes and SPI bytes are handed to any attached ST7036
+ * simulators (see st7036_sim.h), and time is a virtual clock that only
+ * moves when the code waits or touches the bus. A run therefore reports
+ * exact modeled bus time and byte counts, independent of the host.
+ *
+ * Build the library for the host by compiling firmware/do_DogLcd.cpp
+ * together with hal_host.cpp and st7036_sim.cpp, with both /firmware
+ * and /host on the include path (see host_demo.cpp).
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_HAL_HOST_h
+#define do_HAL_HOST_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+#define SPI_CLOCK_DIV2 2
+#define SPI_CLOCK_DIV4 4
+#define SPI_CLOCK_DIV8 8
+#define SPI_CLOCK_DIV16 16
+#define SPI_CLOCK_DIV32 32
+#define SPI_CLOCK_DIV64 64
+#define SPI_CLOCK_DIV128 128
+#define SPI_CLOCK_DIV256 256
+
+/** the hardware SPI pins, numbered as on the Particle Core */
+#define MOSI 15
+#define SCK 13
+#define SS 12
+
+#define DEC 10
+#define HEX 16
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+typedef uint8_t byte;
+
+/** number of pins the host backend keeps track of */
+#define HOST_PINS 64
+/** number of simulators that can listen on the bus */
+#define HOST_MAX_DEVICES 8
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+/** the host's stand-in for a direct port register write */
+void pinWriteFast(int pin, int value);
+int digitalRead(int pin);
+void analogWrite(int pin, int value);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long micros();
+unsigned long millis();
+
+/** the SPI library has beginTransaction()/endTransaction() */
+#define SPI_HAS_TRANSACTION 1
+
+class SPISettings {
+ public:
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass {
+ public:
+    void begin();
+    void end();
+    void setBitOrder(uint8_t bitOrder);
+    void setDataMode(uint8_t mode);
+    void setClockDivider(int divider);
+    /** like on the Arduino, the clock is rounded down to a divider of cpuHz */
+    void beginTransaction(const SPISettings &settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t value);
+    /**
+     * Like the DMA transfer of the Photon: the bytes go out in the
+     * background at the current clock, one every eight clock periods of
+     * the virtual clock, and callback runs when the last is complete.
+     * At most 256 bytes.
+     */
+    void transfer(void* tx, void* rx, size_t length, void (*callback)(void));
+};
+
+extern SPIClass SPI;
+
+/**
+ * Anything that wants to watch the bus (the ST7036 simulator) implements
+ * this and registers itself with HostHal::attach().
+ */
+class HostDevice {
+ public:
+    virtual ~HostDevice() {}
+    /** called after every digitalWrite() that changed a pin */
+    virtual void pinChanged(int pin, int value) = 0;
+    /** called for every byte sent through the hardware SPI */
+    virtual void spiByte(uint8_t value) = 0;
+};
+
+/**
+ * The state of the host backend: virtual clock, cost model and counters.
+ * All times are in nanoseconds of modeled (not host) time.
+ */
+namespace HostHal {
+
+    /** what a run has cost, see stats() */
+    struct Stats {
+        /** modeled time elapsed since the last resetStats() */
+        uint64_t elapsedNs;
+        /** part of elapsedNs spent in delay()/delayMicroseconds() */
+        uint64_t delayNs;
+        /** bytes sent through the hardware SPI */
+        uint32_t spiBytes;
+        /** SPI transactions begun */
+        uint32_t spiTransactions;
+        /** DMA transfers started */
+        uint32_t dmaTransfers;
+        /** calls to digitalWrite() */
+        uint32_t pinWrites;
+        /** direct (register) pin writes through pinWriteFast() */
+        uint32_t fastPinWrites;
+        /** level changes, per pin */
+        uint32_t pinEdges[HOST_PINS];
+    };
+
+    /** modeled cost of one digitalWrite(), default 500ns */
+    extern uint32_t pinWriteNs;
+    /** modeled cost of one pinWriteFast(), default 30ns */
+    extern uint32_t fastPinWriteNs;
+    /** modeled CPU clock the SPI divider applies to, default 72MHz (Spark Core) */
+    extern uint32_t cpuHz;
+
+    /** the virtual clock */
+    uint64_t nowNs();
+    /** move the virtual clock forward, e.g. to model application work */
+    void advanceNs(uint64_t ns);
+
+    const Stats& stats();
+    void resetStats();
+
+    /** current level of a pin */
+    int pin(int pin);
+
+    /** let a device watch pin changes and SPI bytes */
+    bool attach(HostDevice* device);
+    void detach(HostDevice* device);
+
+    /**
+     * The backend is guarded by one (recursive) lock, so a timer thread
+     * and the main program can share it. Holding the lock is what
+     * "interrupts off" means on the host.
+     */
+    void lock();
+    void unlock();
+
+    /**
+     * Stand-in for a timer interrupt: calls callback(arg) from a thread
+     * every periodUs microseconds of host time, with the lock held. Each
+     * tick also moves the virtual clock forward by periodUs, as the
+     * program would have run on in the meantime.
+     */
+    void startTimer(void (*callback)(void*), void* arg, uint32_t periodUs);
+    void stopTimer();
+}
+
+/**
+ * A minimal stand-in for the Arduino/Particle Print class.
+ */
+class Print {
+ public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) {
+        if(str==NULL)
+            return 0;
+        return write((const uint8_t*)str, strlen(str));
+    }
+    size_t write(const char* buffer, size_t size) {
+        return write((const uint8_t*)buffer, size);
+    }
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base=DEC) { return printNumber(n, base); }
+    size_t print(int n, int base=DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base=DEC) { return printNumber(n, base); }
+    size_t print(long n, int base=DEC);
+    size_t print(unsigned long n, int base=DEC) { return printNumber(n, base); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T value) {
+        size_t n=print(value);
+        return n+println();
+    }
+
+ private:
+    size_t printNumber(unsigned long n, int base);
+};
+
+#endif
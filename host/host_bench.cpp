@@ -0,0 +1,514 @@
+/* dmf
+ * host_bench - benchmarks of do_DogLcd on the host simulator
+ *
+ * Runs every public drawing call against the ST7036 simulator for the
+ * M081, M162 and M163, over hardware and software SPI (with the budgeted
+ * flush, putChar(), loadGlyphs(), a marquee, pages, the asynchronous
+ * queue sent by poll() and paced DMA among them), and prints one
+ * CSV line per benchmark: modeled bus time, the part of it spent
+ * waiting, bytes and CSB edges per call (all from the virtual clock, so
+ * the same on every host), host CPU time per call and the bytes that
+ * reached the simulator before the previous one was executed (at the
+ * datasheet's 380kHz). The last benchmark replays loop() of
+ * do_DogLcd_HelloWorld.ino once. Then four M162 on one bus are written
+ * one after the other, through a DogLcdBus and with their common
+ * header sent by a DogLcdGroup.
+ *
+ *   g++ -O2 -Ifirmware -Ihost firmware/do_*.cpp host/hal_host.cpp \
+ *       host/st7036_sim.cpp host/host_bench.cpp -pthread -o host_bench
+ *   ./host_bench > before.csv
+ *
+ * Diff the output of two driver versions to see what a change costs.
+ * Only the host_ns column depends on the machine. The exit status is 1
+ * if any byte came too early.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include "do_DogLcd.h"
+#include "do_DogLcdBus.h"
+#include "do_DogLcdGroup.h"
+#include "do_DogLcdMarquee.h"
+#include "st7036_sim.h"
+
+/* the pins, as in the Spark test configuration */
+#define PIN_SI 15
+#define PIN_CLK 13
+#define PIN_CSB 12
+#define PIN_RS 11
+#define PIN_RESET 10
+
+/* the CSB pins of the displays that share the bus (and RS) with the
+ * first one in the benchmarks of several displays */
+#define PANELS 4
+static const int panelCsb[PANELS]={PIN_CSB,9,8,7};
+
+/* calls per benchmark */
+#define RUNS 100
+
+/* the oscillator frequency the timing is checked at, typical in the datasheet */
+#define FOSC_CHECKED 380000UL
+
+static const uint8_t arrowDown[8]={0x04,0x04,0x04,0x04,0x15,0x0E,0x04,0x00};
+static const uint8_t arrowUp[8]={0x04,0x0E,0x15,0x04,0x04,0x04,0x04,0x00};
+
+struct Bench {
+    const char *name;
+    /** run before the measurement */
+    void (*setup)(DogLcdhw &lcd);
+    /** the call measured, n counts the runs */
+    void (*run)(DogLcdhw &lcd, int n);
+    /** run after the measurement */
+    void (*teardown)(DogLcdhw &lcd);
+    int runs;
+};
+
+static void none(DogLcdhw &lcd) {
+    (void)lcd;
+}
+
+static void print1(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.print("x");
+}
+
+static void print8(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.print("12345678");
+}
+
+static void print16(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.print("hello, host! 123");
+}
+
+static void print40(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.print("a line of forty characters, all of them.");
+}
+
+static void printNumber(DogLcdhw &lcd, int n) {
+    lcd.setCursor(0,0);
+    lcd.print((long)n);
+}
+
+static void setCursorMoving(DogLcdhw &lcd, int n) {
+    lcd.setCursor(n%2 ? 3 : 0,n%2 ? lcd.getRows()-1 : 0);
+}
+
+static void setCursorSame(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.setCursor(3,0);
+}
+
+static void clear(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.clear();
+}
+
+static void home(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.home();
+}
+
+static void createCharChanging(DogLcdhw &lcd, int n) {
+    lcd.createChar(0,n%2 ? arrowUp : arrowDown);
+}
+
+static void createCharSame(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.createChar(0,arrowDown);
+}
+
+static void setContrast(DogLcdhw &lcd, int n) {
+    lcd.setContrast(n%2 ? 20 : 50);
+}
+
+static void setGain(DogLcdhw &lcd, int n) {
+    lcd.setGain(n%2 ? 2 : 3);
+}
+
+static void scrollLeft(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.scrollDisplayLeft();
+}
+
+static void scrollRight(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.scrollDisplayRight();
+}
+
+/** every visible cell changes */
+static void fullScreen(DogLcdhw &lcd, int n) {
+    for(int row=0; row<lcd.getRows(); row++) {
+        lcd.setCursor(0,row);
+        for(int col=0; col<lcd.getColumns(); col++)
+            lcd.write((uint8_t)('A'+(n+row+col)%26));
+    }
+}
+
+static void fullScreenClear(DogLcdhw &lcd, int n) {
+    lcd.clear();
+    fullScreen(lcd,n);
+}
+
+static void buffered(DogLcdhw &lcd) {
+    lcd.setBuffered(true);
+}
+
+static void direct(DogLcdhw &lcd) {
+    lcd.setBuffered(false);
+}
+
+static void fullScreenFlush(DogLcdhw &lcd, int n) {
+    fullScreen(lcd,n);
+    lcd.flush();
+}
+
+/** a counter field changing among static text */
+static void counterFlush(DogLcdhw &lcd, int n) {
+    lcd.clear();
+    lcd.print("count");
+    lcd.setCursor(0,lcd.getRows()-1);
+    lcd.print((long)n);
+    lcd.flush();
+}
+
+static void drawPage(DogLcdhw &lcd) {
+    lcd.setDrawPage(0);
+}
+
+static void flipPage(DogLcdhw &lcd, int n) {
+    lcd.clear();
+    lcd.print((long)n);
+    lcd.flip();
+}
+
+static void noPage(DogLcdhw &lcd) {
+    lcd.setDrawPage(-1);
+    lcd.home();
+}
+
+/** the full screen with a budget of half a millisecond per flush */
+static void fullScreenBudget(DogLcdhw &lcd, int n) {
+    fullScreen(lcd,n);
+    lcd.flush(500);
+}
+
+static void flushDirect(DogLcdhw &lcd) {
+    lcd.flush();
+    lcd.setBuffered(false);
+}
+
+static void putChar(DogLcdhw &lcd, int n) {
+    lcd.putChar(n%lcd.getColumns(),n%lcd.getRows(),'a'+n%26);
+}
+
+static uint8_t glyphRows[8][8];
+
+/** eight glyphs, one row changing */
+static void loadGlyphs(DogLcdhw &lcd, int n) {
+    glyphRows[n%8][n%7]^=0x11;
+    lcd.loadGlyphs(0,8,glyphRows);
+}
+
+static DogLcdMarquee *marquee;
+
+static void startMarquee(DogLcdhw &lcd) {
+    marquee=new DogLcdMarquee(lcd);
+    marquee->setText(0,"+++ a ticker longer than any line of the display +++");
+}
+
+static void marqueeStep(DogLcdhw &lcd, int n) {
+    (void)lcd;
+    (void)n;
+    marquee->step();
+}
+
+static void stopMarquee(DogLcdhw &lcd) {
+    (void)lcd;
+    marquee->stop();
+    delete marquee;
+    marquee=NULL;
+}
+
+static void showPage(DogLcdhw &lcd, int n) {
+    lcd.showPage(n%lcd.getPageCount());
+}
+
+static void firstPage(DogLcdhw &lcd) {
+    lcd.showPage(0);
+}
+
+static void async(DogLcdhw &lcd) {
+    lcd.setAsync(true);
+}
+
+static void sync(DogLcdhw &lcd) {
+    lcd.setAsync(false);
+}
+
+/** queued, then sent by poll() from a loop() that comes by every 10us */
+static void print16Polled(DogLcdhw &lcd, int n) {
+    print16(lcd,n);
+    while(lcd.queueDepth()>0) {
+        lcd.poll();
+        delayMicroseconds(10);
+    }
+}
+
+/** only the hardware SPI can pace DMA, the software SPI measures plain print() */
+static void pacedDma(DogLcdhw &lcd) {
+    lcd.setPacedDma(true);
+}
+
+static void noPacedDma(DogLcdhw &lcd) {
+    lcd.setPacedDma(false);
+}
+
+/** loop() of do_DogLcd_HelloWorld.ino */
+static void helloWorldLoop(DogLcdhw &lcd, int n) {
+    (void)n;
+    lcd.setCursor(0,1);
+    lcd.print(millis()/1000);
+    delay(2000);
+    lcd.clear();
+    lcd.setCursor(0,1);
+    lcd.print("changed contrast?");
+    delay(2000);
+    lcd.clear();
+    lcd.setCursor(0,0);
+    lcd.print("no blinking");
+    lcd.noBlink();
+    delay(2000);
+    lcd.reset();
+    lcd.setCursor(0,1);
+    lcd.print("no cursor");
+    lcd.noCursor();
+    delay(2000);
+    lcd.clear();
+    lcd.blink();
+    lcd.setCursor(0,0);
+    lcd.print("ELECTRONIC");
+    lcd.setCursor(8,1);
+    lcd.print("ASSEMBLY");
+    delay(3000);
+    lcd.clear();
+    lcd.setCursor(0,0);
+    lcd.print("My new char?");
+    lcd.setCursor(1,1);
+    lcd.ascii(0);
+    lcd.setCursor(3,1);
+    lcd.write((byte)0);
+    lcd.setCursor(5,1);
+    lcd.write("A");
+    delay(1000);
+    lcd.scrollDisplayRight();
+    delay(1000);
+    lcd.scrollDisplayLeft();
+    delay(2000);
+    lcd.reset();
+    lcd.print("spark, again!");
+    delay(1000);
+}
+
+static void helloWorldSetup(DogLcdhw &lcd) {
+    lcd.print("hello, spark!");
+    lcd.createChar(0,arrowDown);
+}
+
+static const Bench benches[]={
+    {"print_1",none,print1,none,RUNS},
+    {"print_8",none,print8,none,RUNS},
+    {"print_16",none,print16,none,RUNS},
+    {"print_40",none,print40,none,RUNS},
+    {"print_number",none,printNumber,none,RUNS},
+    {"setCursor",none,setCursorMoving,none,RUNS},
+    {"setCursor_same",none,setCursorSame,none,RUNS},
+    {"clear",none,clear,none,RUNS},
+    {"home",none,home,none,RUNS},
+    {"createChar",none,createCharChanging,none,RUNS},
+    {"createChar_same",none,createCharSame,none,RUNS},
+    {"setContrast",none,setContrast,none,RUNS},
+    {"setGain",none,setGain,none,RUNS},
+    {"scrollDisplayLeft",none,scrollLeft,none,RUNS},
+    {"scrollDisplayRight",none,scrollRight,none,RUNS},
+    {"fullscreen_direct",none,fullScreen,none,RUNS},
+    {"fullscreen_clear",none,fullScreenClear,none,RUNS},
+    {"fullscreen_buffered",buffered,fullScreenFlush,direct,RUNS},
+    {"counter_buffered",buffered,counterFlush,direct,RUNS},
+    {"page_flip",drawPage,flipPage,noPage,RUNS},
+    {"fullscreen_budget_500",buffered,fullScreenBudget,flushDirect,RUNS},
+    {"putChar",none,putChar,none,RUNS},
+    {"loadGlyphs_8",none,loadGlyphs,none,RUNS},
+    {"marquee_step",startMarquee,marqueeStep,stopMarquee,RUNS},
+    {"showPage",none,showPage,firstPage,RUNS},
+    {"print_16_async_poll",async,print16Polled,sync,RUNS},
+    {"print_16_paced_dma",pacedDma,print16,noPacedDma,RUNS},
+    {"helloworld_loop",helloWorldSetup,helloWorldLoop,none,1},
+};
+
+static const struct {
+    int model;
+    const char *name;
+} models[]={
+    {DOG_LCDhw_M081,"M081"},
+    {DOG_LCDhw_M162,"M162"},
+    {DOG_LCDhw_M163,"M163"},
+};
+
+/** @return the bytes that came too early */
+static uint32_t measure(const Bench &bench, DogLcdhw &lcd, St7036Sim &sim,
+                        const char *model, const char *spi) {
+    lcd.clear();
+    bench.setup(lcd);
+    // the setup's last byte must not count against the benchmark
+    delayMicroseconds(2000);
+    HostHal::resetStats();
+    uint32_t commands=sim.commands();
+    uint32_t data=sim.data();
+    uint32_t violations=sim.violations();
+    std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    for(int n=0; n<bench.runs; n++)
+        bench.run(lcd,n);
+    std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+    const HostHal::Stats &s=HostHal::stats();
+    double runs=bench.runs;
+    double hostNs=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    violations=sim.violations()-violations;
+    printf("%s,%s,%s,%d,%.1f,%.1f,%.2f,%.2f,%.2f,%.0f,%u\n",
+           bench.name,model,spi,bench.runs,
+           s.elapsedNs/1000.0/runs,s.delayNs/1000.0/runs,
+           (sim.commands()-commands)/runs,(sim.data()-data)/runs,
+           s.pinEdges[PIN_CSB]/runs,hostNs/runs,(unsigned)violations);
+    bench.teardown(lcd);
+    return violations;
+}
+
+/** how the benchmarks of several displays reach them */
+enum {
+    PANELS_SEQUENTIAL,
+    PANELS_BUS,
+    PANELS_GROUP
+};
+
+/** a header the same on every panel and a line of its own, a screen per call */
+static void drawPanels(DogLcdhw **lcds, DogLcdGroup *group, int n) {
+    if(group!=NULL) {
+        group->setCursor(0,0);
+        group->print("== the header ==");
+    }
+    for(int i=0; i<PANELS; i++) {
+        if(group==NULL) {
+            lcds[i]->setCursor(0,0);
+            lcds[i]->print("== the header ==");
+        }
+        lcds[i]->setCursor(0,1);
+        lcds[i]->print("panel ");
+        lcds[i]->print((long)i);
+        lcds[i]->print(" #");
+        lcds[i]->print((long)n+100000);
+        lcds[i]->print(" ");
+    }
+}
+
+/**
+ * Measure drawing on PANELS M162 over the hardware SPI: one display
+ * after the other, with all of them on a DogLcdBus, or with the header
+ * sent to all at once by a DogLcdGroup.
+ * @return the bytes that came too early
+ */
+static uint32_t measurePanels(const char *name, int mode) {
+    DogLcdhw *lcds[PANELS];
+    St7036Sim *sims[PANELS];
+    DogLcdBus bus;
+    DogLcdGroup group;
+    for(int i=0; i<PANELS; i++) {
+        lcds[i]=new DogLcdhw(0,0,panelCsb[i],PIN_RS);
+        sims[i]=new St7036Sim(panelCsb[i],PIN_RS);
+        sims[i]->checkTiming(FOSC_CHECKED);
+        if(mode==PANELS_GROUP)
+            group.add(*lcds[i]);
+        else
+            lcds[i]->begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        if(mode==PANELS_BUS)
+            bus.add(*lcds[i]);
+    }
+    if(mode==PANELS_GROUP)
+        group.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    delayMicroseconds(2000);
+    HostHal::resetStats();
+    uint32_t commands=0, data=0, edges=0, violations=0;
+    for(int i=0; i<PANELS; i++) {
+        commands-=sims[i]->commands();
+        data-=sims[i]->data();
+    }
+    std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    for(int n=0; n<RUNS; n++) {
+        drawPanels(lcds,mode==PANELS_GROUP ? &group : NULL,n);
+        if(mode==PANELS_BUS)
+            bus.waitIdle();
+    }
+    std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+    const HostHal::Stats &s=HostHal::stats();
+    for(int i=0; i<PANELS; i++) {
+        commands+=sims[i]->commands();
+        data+=sims[i]->data();
+        edges+=s.pinEdges[panelCsb[i]];
+        violations+=sims[i]->violations();
+    }
+    double runs=RUNS;
+    double hostNs=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    printf("%s,M162,hw,%d,%.1f,%.1f,%.2f,%.2f,%.2f,%.0f,%u\n",
+           name,RUNS,s.elapsedNs/1000.0/runs,s.delayNs/1000.0/runs,
+           commands/runs,data/runs,edges/runs,hostNs/runs,(unsigned)violations);
+    for(int i=0; i<PANELS; i++) {
+        delete lcds[i];
+        delete sims[i];
+    }
+    return violations;
+}
+
+int main() {
+    printf("bench,model,spi,calls,bus_us,wait_us,commands,data,csb_edges,host_ns,violations\n");
+    uint32_t violations=0;
+    for(size_t m=0; m<sizeof(models)/sizeof(models[0]); m++) {
+        for(int hardware=1; hardware>=0; hardware--) {
+            // lcdSI==lcdCLK selects the hardware SPI, where CSB is SS
+            DogLcdhw lcd(hardware ? 0 : PIN_SI,hardware ? 0 : PIN_CLK,PIN_CSB,PIN_RS,PIN_RESET);
+            St7036Sim sim(PIN_CSB,PIN_RS,hardware ? -1 : PIN_SI,hardware ? -1 : PIN_CLK);
+            const char *spi=hardware ? "hw" : "sw";
+            sim.checkTiming(FOSC_CHECKED);
+            HostHal::resetStats();
+            uint32_t commands=sim.commands();
+            std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+            lcd.begin(models[m].model,DOG_LCDhw_VCC_3V3,-1,-1);
+            std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+            const HostHal::Stats &s=HostHal::stats();
+            printf("begin,%s,%s,1,%.1f,%.1f,%u,%u,%u,%lld,%u\n",models[m].name,spi,
+                   s.elapsedNs/1000.0,s.delayNs/1000.0,sim.commands()-commands,sim.data(),
+                   s.pinEdges[PIN_CSB],
+                   (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count(),
+                   (unsigned)sim.violations());
+            violations+=sim.violations();
+            for(size_t b=0; b<sizeof(benches)/sizeof(benches[0]); b++)
+                violations+=measure(benches[b],lcd,sim,models[m].name,spi);
+        }
+    }
+    violations+=measurePanels("panels_4_sequential",PANELS_SEQUENTIAL);
+    violations+=measurePanels("panels_4_bus",PANELS_BUS);
+    violations+=measurePanels("panels_4_group",PANELS_GROUP);
+    if(violations>0) {
+        fprintf(stderr,"%u bytes reached the display before it was ready\n",(unsigned)violations);
+        return 1;
+    }
+    return 0;
+}
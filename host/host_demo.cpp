@@ -0,0 +1,56 @@
+/* dmf
+ * host_demo - do_DogLcd on a Linux host
+ *
+ * Runs the library against the ST7036 simulator, shows what the
+ * display would look like and what it cost in modeled bus time.
+ *
+ *   g++ -Ifirmware -Ihost firmware/do_DogLcd.cpp host/hal_host.cpp \
+ *       host/st7036_sim.cpp host/host_demo.cpp -pthread -o host_demo
+ */
+
+#include <stdio.h>
+#include "do_DogLcd.h"
+#include "st7036_sim.h"
+
+static void show(const St7036Sim& sim, int rows, int cols) {
+    char line[81];
+    for(int row=0; row<rows; row++) {
+        sim.visibleLine(row, cols, line);
+        printf("  |%s|\n", line);
+    }
+}
+
+static void report(const char* what) {
+    const HostHal::Stats& s=HostHal::stats();
+    printf("%-24s %10.1f us  (%.1f us waiting), %u SPI bytes, %u+%u pin writes\n",
+           what, s.elapsedNs/1000.0, s.delayNs/1000.0, s.spiBytes, s.pinWrites,
+           s.fastPinWrites);
+}
+
+int main() {
+    // hardware SPI, same pins as the Spark test configuration
+    DogLcdhw lcd(0, 0, 12, 11, 10, -1);
+    St7036Sim sim(SS, 11);
+
+    HostHal::resetStats();
+    lcd.begin(DOG_LCDhw_M162, DOG_LCDhw_VCC_3V3, -1, -1);
+    report("begin()");
+
+    HostHal::resetStats();
+    lcd.print("hello, host!");
+    lcd.setCursor(0, 1);
+    lcd.print(12345L);
+    report("print() x2");
+    show(sim, 2, 16);
+
+    lcd.setBuffered(true);
+    HostHal::resetStats();
+    lcd.clear();
+    lcd.print("hello, host!");
+    lcd.setCursor(0, 1);
+    lcd.print(12346L);
+    lcd.flush();
+    report("buffered redraw");
+    show(sim, 2, 16);
+    return 0;
+}
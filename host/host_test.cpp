@@ -0,0 +1,1336 @@
+/* dmf
+ * host_test - checks of do_DogLcd and its helpers on the host simulator
+ *
+ * Each case drives one or more DogLcdhw against ST7036 simulators and
+ * checks what ends up in the controllers (DDRAM, CGRAM, display shift,
+ * the visible lines) or what it cost on the virtual clock. The first
+ * case runs random sequences of drawing calls on a direct, a buffered
+ * and an asynchronous display of each model next to a reference that
+ * gets the plain ST7036 instructions, and prints a failing sequence.
+ *
+ *   g++ -O2 -DDOG_GLYPHS_MAX=160 -Ifirmware -Ihost firmware/do_*.cpp \
+ *       host/hal_host.cpp host/st7036_sim.cpp host/host_test.cpp \
+ *       -pthread -o host_test
+ *   ./host_test [case...]
+ *
+ * Without arguments all cases run. The exit status is 0 if all pass.
+ * DOG_GLYPHS_MAX above 128 lets the glyphs case use handles above 127.
+ * Built with -DDOG_LCDhw_STATS as well, the stats case checks the
+ * counters of getStats(), with -DDOG_LCDhw_TRACE the trace case checks
+ * that the dumps are valid JSON.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "do_DogLcd.h"
+#include "do_DogLcdAnimation.h"
+#include "do_DogLcdBus.h"
+#include "do_DogLcdGlyphs.h"
+#include "do_DogLcdGroup.h"
+#include "do_DogLcdMarquee.h"
+#include "do_DogLcdTrace.h"
+#include "st7036_sim.h"
+
+/* the pins of the displays, all on the hardware SPI */
+#define PIN_CSB_DIRECT 20
+#define PIN_RS_DIRECT 21
+#define PIN_CSB_BUFFERED 22
+#define PIN_RS_BUFFERED 23
+#define PIN_CSB_ASYNC 24
+#define PIN_RS_ASYNC 25
+#define PIN_CSB_REF 26
+#define PIN_RS_REF 27
+/* a display drawn on its own, to compare the others with */
+#define PIN_CSB_ALONE 28
+#define PIN_RS_ALONE 29
+#define PIN_RESET_ALONE 30
+/* a group of six, with CSB on 32..37 and RS and reset shared */
+#define GROUP_SIZE 6
+#define PIN_CSB_GROUP 32
+#define PIN_RS_GROUP 38
+#define PIN_RESET_GROUP 39
+
+static const uint8_t arrowDown[8]={0x04,0x04,0x04,0x04,0x15,0x0E,0x04,0x00};
+static const uint8_t arrowUp[8]={0x04,0x0E,0x15,0x04,0x04,0x04,0x04,0x00};
+
+/**
+ * The reference: every call turned into the instructions the datasheet
+ * asks for, without shadows, state caches or planning.
+ */
+class Reference {
+ public:
+    Reference(int model) {
+        dogPinMode(PIN_CSB_REF,OUTPUT);
+        dogDigitalWrite(PIN_CSB_REF,HIGH);
+        dogPinMode(PIN_RS_REF,OUTPUT);
+        if(model==DOG_LCDhw_M081) {
+            functionSet=0x30;
+            start[0]=0x00;
+        } else if(model==DOG_LCDhw_M162) {
+            functionSet=0x38;
+            start[0]=0x00;
+            start[1]=0x40;
+        } else {
+            functionSet=0x38;
+            start[0]=0x00;
+            start[1]=0x10;
+            start[2]=0x20;
+        }
+        entry=0x06;
+        command(functionSet | 0x01);
+        command(model==DOG_LCDhw_M163 ? 0x15 : 0x14);
+        command(0x57);
+        command(0x72);
+        command(0x6B);
+        command(functionSet);
+        command(0x0E);
+        command(entry);
+        command(0x01);
+    }
+    void print(const std::string &text) {
+        for(size_t i=0; i<text.size(); i++)
+            data(text[i]);
+    }
+    void setCursor(int col, int row) {
+        command(0x80 | (start[row]+col));
+    }
+    void clear() {
+        command(0x01);
+        // the controller goes back to left-to-right
+        entry|=0x02;
+    }
+    void home() {
+        command(0x02);
+    }
+    void scroll(bool left) {
+        command(functionSet);
+        command(left ? 0x18 : 0x1C);
+    }
+    void leftToRight(bool on) {
+        if(on)
+            entry|=0x02;
+        else
+            entry&=~0x02;
+        command(entry);
+    }
+    void createChar(int slot, const uint8_t *map) {
+        /* written in left-to-right entry, so the rows land in order, and
+         * back to DDRAM with a cursor jump (the drivers leave the address
+         * counter where drawing calls set it again) */
+        command(functionSet);
+        command(0x06);
+        command(0x40 | (slot*8));
+        for(int i=0; i<8; i++)
+            data(map[i]);
+        command(entry);
+        command(0x80);
+    }
+
+ private:
+    void send(uint8_t value, int rs) {
+        dogDigitalWrite(PIN_RS_REF,rs);
+        dogDigitalWrite(PIN_CSB_REF,LOW);
+        SPI.transfer(value);
+        dogDigitalWrite(PIN_CSB_REF,HIGH);
+        // well above any execution time
+        dogDelayMicroseconds(2000);
+    }
+    void command(uint8_t cmd) { send(cmd,LOW); }
+    void data(uint8_t value) { send(value,HIGH); }
+
+    uint8_t functionSet;
+    uint8_t start[3];
+    uint8_t entry;
+};
+
+/* Failed checks are printed with their line and fail the running case. */
+static bool casePassed;
+
+#define CHECK(condition) check((condition),#condition,__LINE__)
+
+static bool check(bool ok, const char *what, int line) {
+    if(!ok) {
+        printf("  line %d: %s\n",line,what);
+        casePassed=false;
+    }
+    return ok;
+}
+
+static const char *modelName(int model) {
+    if(model==DOG_LCDhw_M081)
+        return "M081";
+    if(model==DOG_LCDhw_M162)
+        return "M162";
+    return "M163";
+}
+
+/**
+ * Run one random sequence on all four displays.
+ * @return true if the simulators agree afterwards
+ */
+static bool runSequence(int model, unsigned seed, int calls) {
+    DogLcdhw direct(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    DogLcdhw buffered(0,0,PIN_CSB_BUFFERED,PIN_RS_BUFFERED);
+    DogLcdhw async(0,0,PIN_CSB_ASYNC,PIN_RS_ASYNC);
+    St7036Sim simDirect(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim simBuffered(PIN_CSB_BUFFERED,PIN_RS_BUFFERED);
+    St7036Sim simAsync(PIN_CSB_ASYNC,PIN_RS_ASYNC);
+    St7036Sim simRef(PIN_CSB_REF,PIN_RS_REF);
+    // the driver's own displays get nothing before it is executed
+    simDirect.checkTiming(DOG_LCDhw_FOSC);
+    simBuffered.checkTiming(DOG_LCDhw_FOSC);
+    simAsync.checkTiming(DOG_LCDhw_FOSC);
+    DogLcdhw *lcds[3]={&direct,&buffered,&async};
+    for(int i=0; i<3; i++)
+        lcds[i]->begin(model,DOG_LCDhw_VCC_3V3,-1,-1);
+    Reference ref(model);
+    buffered.setBuffered(true);
+    async.setAsync(true);
+
+    srand(seed);
+    int rows=direct.getRows();
+    int line=direct.getLineLength();
+    std::string log;
+    char call[64];
+    for(int n=0; n<calls; n++) {
+        switch(rand()%11) {
+        case 0:
+        case 1:
+        case 2: {
+            std::string text;
+            int len=rand()%20;
+            for(int i=0; i<len; i++)
+                text+=(char)('a'+rand()%26);
+            for(int i=0; i<3; i++)
+                lcds[i]->print(text.c_str());
+            ref.print(text);
+            snprintf(call,sizeof(call),"print(\"%s\"); ",text.c_str());
+            break;
+        }
+        case 3:
+        case 4: {
+            int col=rand()%line;
+            int row=rand()%rows;
+            for(int i=0; i<3; i++)
+                lcds[i]->setCursor(col,row);
+            ref.setCursor(col,row);
+            snprintf(call,sizeof(call),"setCursor(%d,%d); ",col,row);
+            break;
+        }
+        case 5:
+            for(int i=0; i<3; i++)
+                lcds[i]->clear();
+            ref.clear();
+            snprintf(call,sizeof(call),"clear(); ");
+            break;
+        case 6:
+            for(int i=0; i<3; i++)
+                lcds[i]->home();
+            ref.home();
+            snprintf(call,sizeof(call),"home(); ");
+            break;
+        case 7: {
+            bool left=rand()%2;
+            for(int i=0; i<3; i++) {
+                if(left)
+                    lcds[i]->scrollDisplayLeft();
+                else
+                    lcds[i]->scrollDisplayRight();
+            }
+            ref.scroll(left);
+            snprintf(call,sizeof(call),left ? "scrollDisplayLeft(); " : "scrollDisplayRight(); ");
+            break;
+        }
+        case 8: {
+            bool on=rand()%2;
+            for(int i=0; i<3; i++) {
+                if(on)
+                    lcds[i]->leftToRight();
+                else
+                    lcds[i]->rightToLeft();
+            }
+            ref.leftToRight(on);
+            snprintf(call,sizeof(call),on ? "leftToRight(); " : "rightToLeft(); ");
+            break;
+        }
+        case 9: {
+            int slot=rand()%8;
+            const uint8_t *map=(rand()%2) ? arrowUp : arrowDown;
+            for(int i=0; i<3; i++)
+                lcds[i]->createChar(slot,map);
+            ref.createChar(slot,map);
+            snprintf(call,sizeof(call),"createChar(%d,%s); ",slot,map==arrowUp ? "up" : "down");
+            break;
+        }
+        case 10: {
+            // the buffered display catches up, with or without a budget
+            uint32_t budget=rand()%400;
+            if(rand()%2) {
+                buffered.flush();
+                snprintf(call,sizeof(call),"flush(); ");
+            } else {
+                buffered.flush(budget);
+                snprintf(call,sizeof(call),"flush(%u); ",(unsigned)budget);
+            }
+            async.poll();
+            break;
+        }
+        }
+        log+=call;
+    }
+    buffered.flush();
+    async.waitIdle();
+
+    St7036Sim *sims[3]={&simDirect,&simBuffered,&simAsync};
+    const char *names[3]={"direct","buffered","async"};
+    int errors=0;
+    for(int i=0; i<3; i++) {
+        const St7036Sim &sim=*sims[i];
+        for(int address=0; address<128; address++) {
+            if(sim.ddram(address)!=simRef.ddram(address)) {
+                if(errors++<5)
+                    printf("  %s: DDRAM 0x%02X is '%c', expected '%c'\n",names[i],address,
+                           sim.ddram(address),simRef.ddram(address));
+            }
+        }
+        for(int address=0; address<64; address++) {
+            if(sim.cgram(address)!=simRef.cgram(address)) {
+                if(errors++<5)
+                    printf("  %s: CGRAM 0x%02X is 0x%02X, expected 0x%02X\n",names[i],address,
+                           sim.cgram(address),simRef.cgram(address));
+            }
+        }
+        if(sim.displayShift()!=simRef.displayShift()) {
+            if(errors++<5)
+                printf("  %s: display shift is %d, expected %d\n",names[i],
+                       sim.displayShift(),simRef.displayShift());
+        }
+        if(sim.entryMode()!=simRef.entryMode()) {
+            if(errors++<5)
+                printf("  %s: entry mode is 0x%02X, expected 0x%02X\n",names[i],
+                       sim.entryMode(),simRef.entryMode());
+        }
+        if(sim.violations()!=0) {
+            if(errors++<5)
+                printf("  %s: %u bytes too early, the worst by %luns\n",names[i],
+                       (unsigned)sim.violations(),(unsigned long)sim.worstViolationNs());
+        }
+    }
+    if(errors>0)
+        printf("%s seed %u: %d differences after\n  %s\n",modelName(model),seed,errors,log.c_str());
+    return errors==0;
+}
+
+/** direct, buffered and asynchronous drawing end up the same */
+static void testEquivalence() {
+    const int models[]={DOG_LCDhw_M081,DOG_LCDhw_M162,DOG_LCDhw_M163};
+    for(int m=0; m<3; m++) {
+        for(unsigned seed=1; seed<=100; seed++)
+            CHECK(runSequence(models[m],seed,300));
+    }
+}
+
+/** setCursor() outside the display memory is ignored, like on the controller */
+static void testSetCursorRange() {
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    const int bad[][2]={{0,-1},{-1,0},{-1,-1},{40,0},{0,2},{-41,1}};
+    for(int buffered=0; buffered<2; buffered++) {
+        lcd.setBuffered(buffered);
+        for(size_t i=0; i<sizeof(bad)/sizeof(bad[0]); i++) {
+            lcd.clear();
+            lcd.setCursor(3,1);
+            lcd.setCursor(bad[i][0],bad[i][1]);
+            lcd.print("xyz");
+            lcd.flush();
+            int col, row;
+            lcd.getCursor(col,row);
+            CHECK(col==6 && row==1);
+            CHECK(sim.ddram(0x43)=='x' && sim.ddram(0x45)=='z');
+        }
+    }
+    // on a page a negative column doesn't reach into the page before
+    lcd.setBuffered(false);
+    lcd.clear();
+    lcd.setDrawPage(1);
+    lcd.setCursor(2,0);
+    lcd.setCursor(-1,0);
+    lcd.print("p");
+    CHECK(sim.ddram(16+2)=='p' && sim.ddram(15)==' ');
+}
+
+/** clock-paced DMA bursts arrive no faster than the controller executes them */
+static void testPacedDma() {
+    uint32_t cpuHz=HostHal::cpuHz;
+    // the SPI clock of the Photon
+    HostHal::cpuHz=60000000UL;
+    {
+        DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        sim.checkTiming(380000);
+        CHECK(lcd.setPacedDma(true));
+        // past the clear of begin()
+        delay(2);
+        uint64_t since=HostHal::nowNs();
+        lcd.print("DMA text 1234567");
+        // the call only starts the transfer
+        CHECK(HostHal::nowNs()-since<100000ULL);
+        delay(5);
+        lcd.setCursor(0,1);
+        lcd.print("second line");
+        lcd.poll();
+        delay(5);
+        lcd.poll();
+        char line[17];
+        sim.visibleLine(0,16,line);
+        CHECK(strcmp(line,"DMA text 1234567")==0);
+        sim.visibleLine(1,16,line);
+        CHECK(strcmp(line,"second line     ")==0);
+        CHECK(HostHal::pin(PIN_CSB_DIRECT)==HIGH);
+        CHECK(sim.violations()==0);
+        lcd.setPacedDma(false);
+    }
+    HostHal::cpuHz=cpuHz;
+}
+
+/** the marquee moves its texts with the display shift, cheaply */
+static void testMarquee() {
+    const char *news="+++ a news ticker that is longer than the line of forty cells +++";
+    int newsLen=strlen(news);
+    for(int buffered=0; buffered<2; buffered++) {
+        DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        sim.checkTiming(380000);
+        lcd.setBuffered(buffered);
+        // shifted before the marquee starts, with the cursor on
+        lcd.scrollDisplayLeft();
+        lcd.scrollDisplayLeft();
+        DogLcdMarquee ticker(lcd);
+        uint32_t commands=sim.commands();
+        CHECK(ticker.setText(0,news));
+        // a cursor address and a burst, and putting the cursor back
+        CHECK(sim.commands()-commands<=3);
+        CHECK(ticker.setText(1,"short"));
+        char line[17], expected[17];
+        for(int step=0; step<130; step++) {
+            ticker.step();
+            // the view starts two cells in, where the display was shifted
+            int pos=step+3;
+            int period=newsLen+16;
+            for(int col=0; col<16; col++) {
+                int n=(pos+col)%period;
+                expected[col]=n<newsLen ? news[n] : ' ';
+            }
+            expected[16]=0;
+            sim.visibleLine(0,16,line);
+            if(!CHECK(strcmp(line,expected)==0)) {
+                printf("  step %d: |%s| expected |%s|\n",step,line,expected);
+                break;
+            }
+        }
+        ticker.stop();
+        CHECK(sim.displayShift()==0);
+        sim.visibleLine(0,16,line);
+        CHECK(strncmp(line,news,16)==0);
+        sim.visibleLine(1,16,line);
+        CHECK(strcmp(line,"short           ")==0);
+        CHECK(sim.violations()==0);
+    }
+}
+
+/** flush(maxMicros) stays in its budget and sends the urgent and old cells first */
+static void testFlushBudget() {
+    DogLcdhw lcd(0,0,PIN_CSB_BUFFERED,PIN_RS_BUFFERED);
+    St7036Sim sim(PIN_CSB_BUFFERED,PIN_RS_BUFFERED);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    sim.checkTiming(380000);
+    lcd.setBuffered(true);
+    lcd.scrollDisplayLeft();
+    lcd.scrollDisplayLeft();
+    lcd.flush();
+    // a clear() that leaves a return home behind, which alone takes
+    // longer than most of the budgets below
+    lcd.clear();
+    lcd.print("budget");
+    const uint32_t budgets[]={0,20,45,100,1000};
+    for(size_t i=0; i<sizeof(budgets)/sizeof(budgets[0]); i++) {
+        delay(2);
+        uint64_t since=HostHal::nowNs();
+        lcd.flush(budgets[i]);
+        uint64_t elapsed=HostHal::nowNs()-since;
+        if(!CHECK(elapsed<=budgets[i]*1000ULL))
+            printf("  budget %uus took %luns\n",(unsigned)budgets[i],(unsigned long)elapsed);
+        CHECK(sim.displayShift()==2);
+    }
+    CHECK(sim.ddram(0)=='b');
+    delay(2);
+    uint64_t since=HostHal::nowNs();
+    lcd.flush(2000);
+    CHECK(HostHal::nowNs()-since<=2000000ULL);
+    CHECK(sim.displayShift()==0);
+    char line[17];
+    sim.visibleLine(0,16,line);
+    CHECK(strcmp(line,"budget          ")==0);
+
+    // an address and one cell fit: the high priority row goes first
+    lcd.setPriority(0,1,16,9);
+    lcd.setCursor(0,0);
+    lcd.print("low");
+    lcd.setCursor(8,1);
+    lcd.print("high");
+    delay(2);
+    lcd.flush(60);
+    CHECK(sim.ddram(0x48)=='h' && sim.ddram(0)=='b');
+    // then the rest of the row goes without another address
+    delay(2);
+    lcd.flush(60);
+    delay(2);
+    lcd.flush(60);
+    sim.visibleLine(1,16,line);
+    CHECK(strcmp(line,"        high    ")==0);
+    CHECK(sim.ddram(0)=='b');
+    lcd.flush();
+    // among equal priorities the cell that waited longer goes first
+    lcd.setCursor(12,0);
+    lcd.print("A");
+    delay(2);
+    lcd.flush(0);
+    lcd.setCursor(0,0);
+    lcd.print("B");
+    delay(2);
+    lcd.flush(60);
+    CHECK(sim.ddram(12)=='A' && sim.ddram(0)=='l');
+    delay(2);
+    lcd.flush(60);
+    CHECK(sim.ddram(0)=='B');
+    CHECK(sim.violations()==0);
+}
+
+/** the driver waits the datasheet's times, and only as long as setTiming() says */
+static void testTiming() {
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    sim.checkTiming(380000);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    const char *steps="clear, home, print";
+    lcd.print(steps);
+    lcd.clear();
+    lcd.print(steps);
+    lcd.home();
+    lcd.print(steps);
+    CHECK(sim.violations()==0);
+    // too low for the times to fit, the timing stays
+    CHECK(!lcd.setTiming(DOG_LCDhw_FOSC_MIN(0)-1,0));
+    lcd.clear();
+    lcd.print(steps);
+    CHECK(sim.violations()==0);
+    // trimmed below the datasheet: times for a faster oscillator than
+    // the display has
+    CHECK(lcd.setTiming(540000,0));
+    lcd.clear();
+    lcd.print(steps);
+    lcd.home();
+    lcd.print(steps);
+    CHECK(sim.violations()>0);
+    // and back to the default
+    CHECK(lcd.setTiming(DOG_LCDhw_FOSC));
+    delay(2);
+    uint32_t violations=sim.violations();
+    lcd.clear();
+    lcd.print(steps);
+    CHECK(sim.violations()==violations);
+}
+
+/** the drawing of one panel in the bus case, a step at a time */
+static void drawPanel(DogLcdhw &lcd, int panel, int step) {
+    switch(step) {
+    case 0:
+        lcd.print("panel ");
+        lcd.print(panel);
+        break;
+    case 1:
+        lcd.createChar(panel,panel%2 ? arrowUp : arrowDown);
+        lcd.setCursor(3,1);
+        lcd.write((uint8_t)panel);
+        break;
+    case 2:
+        lcd.setCursor(8,1);
+        lcd.print("on a bus");
+        if(panel==2)
+            lcd.scrollDisplayLeft();
+        break;
+    default:
+        lcd.setCursor(10,0);
+        lcd.print((long)panel*1234);
+        break;
+    }
+}
+
+/** displays on a bus end up as they would on their own, in less time */
+static void testBus() {
+    const int csb[4]={PIN_CSB_DIRECT,PIN_CSB_BUFFERED,PIN_CSB_ASYNC,PIN_CSB_REF};
+    const int steps=4;
+    DogLcdhw a(0,0,csb[0],PIN_RS_DIRECT), b(0,0,csb[1],PIN_RS_DIRECT);
+    DogLcdhw c(0,0,csb[2],PIN_RS_DIRECT), d(0,0,csb[3],PIN_RS_DIRECT);
+    DogLcdhw *lcds[4]={&a,&b,&c,&d};
+    St7036Sim s0(csb[0],PIN_RS_DIRECT), s1(csb[1],PIN_RS_DIRECT);
+    St7036Sim s2(csb[2],PIN_RS_DIRECT), s3(csb[3],PIN_RS_DIRECT);
+    St7036Sim *sims[4]={&s0,&s1,&s2,&s3};
+    DogLcdBus bus;
+    for(int i=0; i<4; i++) {
+        sims[i]->checkTiming(DOG_LCDhw_FOSC);
+        lcds[i]->begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        CHECK(bus.add(*lcds[i]));
+    }
+    delay(2);
+    uint64_t since=HostHal::nowNs();
+    for(int step=0; step<steps; step++) {
+        for(int i=0; i<4; i++)
+            drawPanel(*lcds[i],i,step);
+        bus.poll();
+    }
+    bus.waitIdle();
+    uint64_t onBus=HostHal::nowNs()-since;
+    CHECK(bus.queueDepth()==0);
+
+    uint64_t alone=0;
+    for(int i=0; i<4; i++) {
+        DogLcdhw lcd(0,0,PIN_CSB_ALONE,PIN_RS_ALONE);
+        St7036Sim sim(PIN_CSB_ALONE,PIN_RS_ALONE);
+        lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        delay(2);
+        since=HostHal::nowNs();
+        for(int step=0; step<steps; step++)
+            drawPanel(lcd,i,step);
+        alone+=HostHal::nowNs()-since;
+        for(int address=0; address<128; address++) {
+            if(!CHECK(sims[i]->ddram(address)==sim.ddram(address))) {
+                printf("  panel %d: DDRAM 0x%02X is '%c', expected '%c'\n",i,address,
+                       sims[i]->ddram(address),sim.ddram(address));
+                break;
+            }
+        }
+        for(int address=0; address<64; address++)
+            CHECK(sims[i]->cgram(address)==sim.cgram(address));
+        CHECK(sims[i]->displayShift()==sim.displayShift());
+        CHECK(sims[i]->violations()==0);
+    }
+    // the execution times of four displays overlap
+    if(!CHECK(onBus*3<alone))
+        printf("  %luus on the bus, %luus one after the other\n",
+               (unsigned long)(onBus/1000),(unsigned long)(alone/1000));
+}
+
+/** what the group case draws, on the group or on one display */
+template <class Lcd>
+static void drawShared(Lcd &lcd) {
+    lcd.setContrast(40);
+    lcd.createChar(0,arrowDown);
+}
+
+template <class Lcd>
+static void drawHeader(Lcd &lcd) {
+    lcd.setCursor(0,0);
+    lcd.print("== kiosk ==");
+    lcd.write((uint8_t)0);
+    lcd.createChar(1,arrowUp);
+}
+
+/** one display of the group draws on its own in between */
+static void drawSolo(DogLcdhw &lcd) {
+    lcd.setCursor(3,1);
+    lcd.print("solo");
+    lcd.createChar(1,arrowDown);
+}
+
+/** a group ends up as its displays would on their own, and starts at once */
+static void testGroup() {
+    const int solo=2;
+    DogLcdhw *lcds[GROUP_SIZE];
+    St7036Sim *sims[GROUP_SIZE];
+    DogLcdGroup group;
+    for(int i=0; i<GROUP_SIZE; i++) {
+        lcds[i]=new DogLcdhw(0,0,PIN_CSB_GROUP+i,PIN_RS_GROUP,PIN_RESET_GROUP);
+        sims[i]=new St7036Sim(PIN_CSB_GROUP+i,PIN_RS_GROUP);
+        sims[i]->checkTiming(DOG_LCDhw_FOSC);
+        CHECK(group.add(*lcds[i]));
+    }
+    uint64_t since=HostHal::nowNs();
+    CHECK(group.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1)==0);
+    uint64_t groupBegin=HostHal::nowNs()-since;
+    HostHal::resetStats();
+    drawShared(group);
+    drawSolo(*lcds[solo]);
+    drawHeader(group);
+    uint32_t groupBytes=HostHal::stats().spiBytes;
+
+    uint64_t aloneBegin=0;
+    uint32_t aloneBytes=0;
+    for(int i=0; i<GROUP_SIZE; i++) {
+        DogLcdhw lcd(0,0,PIN_CSB_ALONE,PIN_RS_ALONE,PIN_RESET_ALONE);
+        St7036Sim sim(PIN_CSB_ALONE,PIN_RS_ALONE);
+        since=HostHal::nowNs();
+        lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        aloneBegin+=HostHal::nowNs()-since;
+        HostHal::resetStats();
+        drawShared(lcd);
+        if(i==solo)
+            drawSolo(lcd);
+        drawHeader(lcd);
+        aloneBytes+=HostHal::stats().spiBytes;
+        bool same=true;
+        for(int address=0; address<128; address++)
+            same=same && sims[i]->ddram(address)==sim.ddram(address);
+        for(int address=0; address<64; address++)
+            same=same && sims[i]->cgram(address)==sim.cgram(address);
+        same=same && sims[i]->contrast()==sim.contrast();
+        if(!CHECK(same))
+            printf("  display %d differs from one drawn on its own\n",i);
+        CHECK(sims[i]->violations()==0);
+    }
+    char line[17];
+    sims[solo]->visibleLine(1,16,line);
+    CHECK(strcmp(line,"   solo         ")==0);
+    sims[0]->visibleLine(0,16,line);
+    // with the user-defined char after it
+    CHECK(strncmp(line,"== kiosk ==",11)==0 && sims[0]->ddram(11)==0);
+    // the shared calls went out once
+    CHECK(groupBytes*3<aloneBytes);
+    // the reset waits ran side by side: 80ms instead of 480ms for six
+    if(!CHECK(groupBegin<=81000000ULL && aloneBegin>=480000000ULL))
+        printf("  begin took %luus, one after the other %luus\n",
+               (unsigned long)(groupBegin/1000),(unsigned long)(aloneBegin/1000));
+    for(int i=0; i<GROUP_SIZE; i++) {
+        delete lcds[i];
+        delete sims[i];
+    }
+}
+
+/** a glyph for every handle, each different from the others */
+static uint8_t glyphMaps[DOG_GLYPHS_MAX][8];
+
+/** check that a CGRAM slot holds a glyph */
+static bool slotHolds(const St7036Sim &sim, int slot, int handle) {
+    for(int row=0; row<8; row++) {
+        if(sim.cgram(slot*8+row)!=glyphMaps[handle][row])
+            return false;
+    }
+    return true;
+}
+
+/** the glyph cache only evicts slots no cell shows, least recently used first */
+static void testGlyphs() {
+    for(int h=0; h<DOG_GLYPHS_MAX; h++) {
+        for(int row=0; row<8; row++)
+            glyphMaps[h][row]=row<3 ? (h>>(5*row)) & 0x1F : row;
+    }
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    sim.checkTiming(DOG_LCDhw_FOSC);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    DogLcdGlyphs glyphs(lcd);
+    for(int h=0; h<DOG_GLYPHS_MAX; h++)
+        CHECK(glyphs.add(glyphMaps[h])==h);
+    CHECK(glyphs.add(glyphMaps[0])==-1);
+
+    // the first eight take the free slots
+    for(int h=0; h<8; h++)
+        CHECK(glyphs.print(h)==1);
+    for(int h=0; h<8; h++)
+        CHECK(glyphs.slotOf(h)==h && slotHolds(sim,h,h) && sim.ddram(h)==h);
+    // all of them are on the display
+    CHECK(glyphs.print(8)==0);
+
+    lcd.setCursor(2,0);
+    lcd.print(' ');
+    lcd.setCursor(5,0);
+    lcd.print(' ');
+    // a hit loads nothing, and makes slot 5 the older of the free ones
+    lcd.setCursor(0,1);
+    uint32_t commands=sim.commands();
+    CHECK(glyphs.print(2)==1);
+    CHECK(sim.commands()==commands && sim.ddram(0x40)==2);
+    lcd.setCursor(0,1);
+    lcd.print(' ');
+    CHECK(glyphs.print(8)==1);
+    CHECK(glyphs.slotOf(8)==5 && glyphs.slotOf(5)==-1 && slotHolds(sim,5,8));
+    CHECK(slotHolds(sim,2,2));
+
+    // code 10 shows slot 2 as well, which keeps it
+    lcd.setCursor(2,0);
+    lcd.write((uint8_t)10);
+    CHECK(glyphs.print(9)==0);
+    CHECK(slotHolds(sim,2,2));
+
+#if DOG_GLYPHS_MAX>128
+    // handles above 127 are slots like any other
+    lcd.clear();
+    CHECK(glyphs.print(130)==1);
+    int slot=glyphs.slotOf(130);
+    CHECK(slot>=0 && slotHolds(sim,slot,130) && sim.ddram(0)==slot);
+    CHECK(glyphs.print(DOG_GLYPHS_MAX-1)==1);
+    CHECK(glyphs.slotOf(130)==slot);
+    commands=sim.commands();
+    uint32_t data=sim.data();
+    CHECK(glyphs.print(130)==1);
+    CHECK(sim.commands()==commands && sim.data()==data+1);
+    CHECK(slotHolds(sim,glyphs.slotOf(DOG_GLYPHS_MAX-1),DOG_GLYPHS_MAX-1));
+#endif
+    CHECK(sim.violations()==0);
+}
+
+/** check that the CGRAM holds count glyphs from a slot on */
+static bool cgramHolds(const St7036Sim &sim, int firstSlot, int count, const uint8_t (*maps)[8]) {
+    for(int i=0; i<count*8; i++) {
+        if(sim.cgram(firstSlot*8+i)!=maps[i/8][i%8])
+            return false;
+    }
+    return true;
+}
+
+/** loadGlyphs() only sends the rows the CGRAM doesn't hold yet */
+static void testLoadGlyphs() {
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    sim.checkTiming(DOG_LCDhw_FOSC);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    uint8_t maps[4][8];
+    for(int i=0; i<32; i++)
+        maps[i/8][i%8]=(i*7+3) & 0x1F;
+    // without a cursor to put back: back to instruction table 0 from
+    // begin(), an address and a burst
+    lcd.noCursor();
+    uint32_t commands=sim.commands();
+    uint32_t data=sim.data();
+    lcd.loadGlyphs(2,4,maps);
+    CHECK(cgramHolds(sim,2,4,maps));
+    CHECK(sim.commands()-commands==2 && sim.data()-data==32);
+    // nothing, the shadow knows the CGRAM holds them
+    commands=sim.commands();
+    data=sim.data();
+    lcd.loadGlyphs(2,4,maps);
+    CHECK(sim.commands()==commands && sim.data()==data);
+    // one row, and two with an unchanged row between them as one run
+    maps[1][4]^=0x11;
+    maps[3][0]^=0x01;
+    maps[3][2]^=0x02;
+    commands=sim.commands();
+    data=sim.data();
+    lcd.loadGlyphs(2,4,maps);
+    CHECK(cgramHolds(sim,2,4,maps));
+    CHECK(sim.commands()-commands==2 && sim.data()-data==4);
+
+    // a visible cursor is put back where it was
+    lcd.cursor();
+    lcd.setCursor(5,1);
+    maps[0][0]^=0x04;
+    lcd.loadGlyphs(2,4,maps);
+    CHECK(!sim.inCgram() && sim.addressCounter()==0x45);
+    lcd.print('x');
+    CHECK(sim.ddram(0x45)=='x');
+    // right to left the runs are sent from their last row
+    lcd.rightToLeft();
+    maps[2][1]^=0x08;
+    maps[2][2]^=0x08;
+    lcd.loadGlyphs(2,4,maps);
+    CHECK(cgramHolds(sim,2,4,maps));
+    lcd.leftToRight();
+
+    // a reset without the reset line keeps the CGRAM, and the shadow
+    lcd.reset();
+    data=sim.data();
+    lcd.loadGlyphs(2,4,maps);
+    CHECK(sim.data()==data && cgramHolds(sim,2,4,maps));
+    // slots outside 0..7 are refused
+    commands=sim.commands();
+    lcd.loadGlyphs(6,3,maps);
+    lcd.loadGlyphs(-1,2,maps);
+    CHECK(sim.commands()==commands);
+    CHECK(sim.violations()==0);
+}
+
+/** a spinner: the frames differ in the rows 1..5 only */
+static const uint8_t spinner[4][8]={
+    {0x00,0x04,0x04,0x04,0x04,0x04,0x00,0x00},
+    {0x00,0x01,0x02,0x04,0x08,0x10,0x00,0x00},
+    {0x00,0x00,0x00,0x1F,0x00,0x00,0x00,0x00},
+    {0x00,0x10,0x08,0x04,0x02,0x01,0x00,0x00},
+};
+
+/** animations rewrite only the changed CGRAM rows, the cells stay */
+static void testAnimation() {
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    sim.checkTiming(DOG_LCDhw_FOSC);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    DogLcdAnimation anim(lcd);
+    CHECK(!anim.play(8,spinner,4,100));
+    CHECK(!anim.play(0,spinner,0,100));
+    CHECK(anim.play(0,spinner,4,100));
+    CHECK(cgramHolds(sim,0,1,&spinner[0]));
+    lcd.setCursor(15,0);
+    lcd.write((uint8_t)0);
+    lcd.setCursor(0,1);
+    lcd.write((uint8_t)0);
+    // eight frames, twice around the loop
+    for(int n=1; n<=8; n++) {
+        delay(100);
+        uint32_t data=sim.data();
+        anim.poll();
+        CHECK(cgramHolds(sim,0,1,&spinner[n%4]));
+        // the rows that changed, and one unchanged between two of them
+        if(!CHECK(sim.data()-data>=4 && sim.data()-data<=5))
+            printf("  frame %d: %u rows sent\n",n,(unsigned)(sim.data()-data));
+        CHECK(sim.ddram(15)==0 && sim.ddram(0x40)==0);
+    }
+    // not due yet
+    delay(50);
+    uint32_t data=sim.data();
+    anim.poll();
+    CHECK(sim.data()==data);
+
+    // a second slot, once through: it stops on its last frame
+    CHECK(anim.play(1,spinner,3,100,false));
+    CHECK(anim.isPlaying(1));
+    for(int n=0; n<4; n++) {
+        delay(100);
+        anim.poll();
+    }
+    CHECK(!anim.isPlaying(1) && cgramHolds(sim,1,1,&spinner[2]));
+    CHECK(anim.isPlaying(0));
+
+    // with both due and time for one, the other goes on the next call
+    CHECK(anim.play(1,spinner,4,100));
+    delay(100);
+    uint8_t before[2][8];
+    for(int i=0; i<16; i++)
+        before[i/8][i%8]=sim.cgram(i);
+    int moved[2];
+    for(int call=0; call<2; call++) {
+        anim.poll(1);
+        moved[call]=0;
+        for(int slot=0; slot<2; slot++)
+            moved[call]+=!cgramHolds(sim,slot,1,&before[slot]);
+    }
+    CHECK(moved[0]==1 && moved[1]==2);
+    anim.stop(0);
+    anim.stop(1);
+    CHECK(!anim.isPlaying(0) && !anim.isPlaying(1));
+    CHECK(sim.violations()==0);
+}
+
+/** pages are drawn out of view and appear whole with the display shift */
+static void testPages() {
+    char line[17];
+    for(int buffered=0; buffered<2; buffered++) {
+        DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        sim.checkTiming(DOG_LCDhw_FOSC);
+        lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        lcd.setBuffered(buffered);
+        CHECK(lcd.getPageCount()==2);
+        CHECK(!lcd.setDrawPage(2));
+        lcd.print("page zero");
+        CHECK(lcd.setDrawPage(1));
+        lcd.print("page one");
+        lcd.setCursor(0,1);
+        lcd.print("drawn unseen");
+        lcd.flush();
+        // nothing of it shows yet
+        sim.visibleLine(0,16,line);
+        CHECK(strcmp(line,"page zero       ")==0);
+        sim.visibleLine(1,16,line);
+        CHECK(strcmp(line,"                ")==0);
+        lcd.flip();
+        CHECK(lcd.getShownPage()==1 && lcd.getDrawPage()==0);
+        sim.visibleLine(0,16,line);
+        CHECK(strcmp(line,"page one        ")==0);
+        sim.visibleLine(1,16,line);
+        CHECK(strcmp(line,"drawn unseen    ")==0);
+        // clear() only blanks the page drawn into
+        lcd.clear();
+        lcd.print("zero again");
+        sim.visibleLine(0,16,line);
+        CHECK(strcmp(line,"page one        ")==0);
+        lcd.flip();
+        CHECK(lcd.getShownPage()==0 && lcd.getDrawPage()==1);
+        sim.visibleLine(0,16,line);
+        CHECK(strcmp(line,"zero again      ")==0);
+        // text past the right edge goes on into the next page
+        lcd.setDrawPage(0);
+        lcd.setCursor(14,1);
+        lcd.print("edge");
+        lcd.flush();
+        CHECK(lcd.showPage(1));
+        sim.visibleLine(1,16,line);
+        CHECK(strcmp(line,"geawn unseen    ")==0);
+        CHECK(sim.violations()==0);
+    }
+
+    // the M081 takes the shorter way round its ten pages
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    sim.checkTiming(DOG_LCDhw_FOSC);
+    lcd.begin(DOG_LCDhw_M081,DOG_LCDhw_VCC_3V3,-1,-1);
+    CHECK(lcd.getPageCount()==10);
+    lcd.setDrawPage(9);
+    lcd.print("last");
+    uint32_t commands=sim.commands();
+    CHECK(lcd.showPage(9));
+    // eight shifts right, after going back to instruction table 0
+    CHECK(sim.commands()-commands<=9);
+    sim.visibleLine(0,8,line);
+    CHECK(strcmp(line,"last    ")==0);
+    CHECK(!lcd.showPage(10) && lcd.getShownPage()==9);
+    CHECK(sim.violations()==0);
+}
+
+#if defined(DOG_LCDhw_STATS)
+/** getStats() counts what the simulator receives */
+static void testStats() {
+    for(int mode=0; mode<3; mode++) {
+        DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+        lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+        lcd.setBuffered(mode==1);
+        lcd.setAsync(mode==2);
+        delay(2);
+        lcd.resetStats();
+        HostHal::resetStats();
+        uint32_t commands=sim.commands();
+        uint32_t data=sim.data();
+        lcd.print("statistics");
+        lcd.setCursor(4,1);
+        lcd.print((long)-1234);
+        lcd.createChar(3,arrowUp);
+        lcd.setCursor(0,1);
+        lcd.clear();
+        lcd.scrollDisplayLeft();
+        lcd.setContrast(30);
+        lcd.print("again");
+        lcd.home();
+        lcd.flush();
+        lcd.waitIdle();
+        const DogLcdStats &s=lcd.getStats();
+        if(!CHECK(s.dataBytes==sim.data()-data && s.commandBytes==sim.commands()-commands))
+            printf("  %s: %u data, %u commands counted, %u and %u received\n",
+                   mode==0 ? "direct" : mode==1 ? "buffered" : "async",
+                   (unsigned)s.dataBytes,(unsigned)s.commandBytes,
+                   (unsigned)(sim.data()-data),(unsigned)(sim.commands()-commands));
+        uint32_t classified=0;
+        for(int i=0; i<DOG_OPCODE_CLASSES; i++)
+            classified+=s.commands[i];
+        CHECK(classified==s.commandBytes);
+        CHECK(s.commands[DOG_OPCODE_CLEAR_HOME]>=1 && s.commands[DOG_OPCODE_TABLE1]>=1);
+        const HostHal::Stats &bus=HostHal::stats();
+        CHECK(s.csbEdges==bus.pinEdges[PIN_CSB_DIRECT]);
+        // the driver is the only one waiting here
+        CHECK(s.blockingMicros<=bus.delayNs/1000+1 && s.blockingMicros+10>=bus.delayNs/1000);
+        int setCursors=0, clears=0;
+        for(int b=0; b<DOG_STAT_BUCKETS; b++) {
+            setCursors+=s.histogram[DOG_STAT_SET_CURSOR][b];
+            clears+=s.histogram[DOG_STAT_CLEAR][b];
+        }
+        CHECK(setCursors==2 && clears==1);
+        lcd.resetStats();
+        CHECK(s.dataBytes==0 && s.commandBytes==0 && s.csbEdges==0);
+    }
+}
+#endif
+
+#if defined(DOG_LCDhw_TRACE)
+/** collects what is printed to it */
+class StringPrint : public Print {
+ public:
+    std::string text;
+    virtual size_t write(uint8_t c) {
+        text+=(char)c;
+        return 1;
+    }
+};
+
+/**
+ * A small JSON parser that only checks the syntax, and collects the
+ * "ph" and "tid" of the trace events on the way.
+ */
+class JsonCheck {
+ public:
+    JsonCheck(const std::string &text) : s(text), pos(0) {}
+
+    /** @return true if the whole text is one JSON value */
+    bool valid() {
+        if(!value())
+            return false;
+        space();
+        return pos==s.size();
+    }
+
+    /** the phases and tracks of the events, in order */
+    std::string phases;
+    std::vector<int> tracks;
+
+ private:
+    const std::string &s;
+    size_t pos;
+    std::string key;
+
+    void space() {
+        while(pos<s.size() && strchr(" \t\r\n",s[pos])!=NULL)
+            pos++;
+    }
+
+    bool literal(const char *word) {
+        size_t len=strlen(word);
+        if(s.compare(pos,len,word)!=0)
+            return false;
+        pos+=len;
+        return true;
+    }
+
+    bool string(std::string *out) {
+        if(pos>=s.size() || s[pos]!='"')
+            return false;
+        pos++;
+        while(pos<s.size() && s[pos]!='"') {
+            if((uint8_t)s[pos]<0x20)
+                return false;
+            if(s[pos]=='\\') {
+                pos++;
+                if(pos>=s.size())
+                    return false;
+                if(s[pos]=='u') {
+                    for(int i=1; i<=4; i++) {
+                        if(pos+i>=s.size() || !isxdigit((uint8_t)s[pos+i]))
+                            return false;
+                    }
+                    pos+=4;
+                } else if(strchr("\"\\/bfnrt",s[pos])==NULL) {
+                    return false;
+                }
+            }
+            if(out!=NULL)
+                *out+=s[pos];
+            pos++;
+        }
+        if(pos>=s.size())
+            return false;
+        pos++;
+        return true;
+    }
+
+    bool number() {
+        size_t start=pos;
+        if(pos<s.size() && s[pos]=='-')
+            pos++;
+        while(pos<s.size() && (isdigit((uint8_t)s[pos]) || strchr(".eE+-",s[pos])!=NULL))
+            pos++;
+        return pos>start && isdigit((uint8_t)s[pos-1]);
+    }
+
+    bool value() {
+        space();
+        if(pos>=s.size())
+            return false;
+        std::string text;
+        switch(s[pos]) {
+        case '{':
+            return object();
+        case '[':
+            return array();
+        case '"':
+            if(!string(&text))
+                return false;
+            if(key=="ph")
+                phases+=text;
+            return true;
+        case 't':
+            return literal("true");
+        case 'f':
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default: {
+            size_t start=pos;
+            if(!number())
+                return false;
+            if(key=="tid")
+                tracks.push_back(atoi(s.c_str()+start));
+            return true;
+        }
+        }
+    }
+
+    bool object() {
+        pos++;
+        space();
+        if(pos<s.size() && s[pos]=='}') {
+            pos++;
+            return true;
+        }
+        while(true) {
+            space();
+            std::string name;
+            if(!string(&name))
+                return false;
+            space();
+            if(pos>=s.size() || s[pos]!=':')
+                return false;
+            pos++;
+            key=name;
+            if(!value())
+                return false;
+            key="";
+            space();
+            if(pos<s.size() && s[pos]==',') {
+                pos++;
+                continue;
+            }
+            if(pos<s.size() && s[pos]=='}') {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool array() {
+        pos++;
+        space();
+        if(pos<s.size() && s[pos]==']') {
+            pos++;
+            return true;
+        }
+        while(true) {
+            if(!value())
+                return false;
+            space();
+            if(pos<s.size() && s[pos]==',') {
+                pos++;
+                continue;
+            }
+            if(pos<s.size() && s[pos]==']') {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+    }
+};
+
+/** check a dump: valid JSON, and no span ends that didn't begin */
+static bool traceValid(const char *when) {
+    StringPrint out;
+    DogLcdTrace::dump(out);
+    JsonCheck json(out.text);
+    if(!json.valid()) {
+        printf("  %s: the trace is no valid JSON\n",when);
+        return false;
+    }
+    if(json.phases.size()!=json.tracks.size()) {
+        printf("  %s: %d events with %d tracks\n",when,(int)json.phases.size(),(int)json.tracks.size());
+        return false;
+    }
+    // tracks are numbered in a byte
+    int open[256]={0};
+    for(size_t i=0; i<json.phases.size(); i++) {
+        int track=json.tracks[i] & 0xFF;
+        if(json.phases[i]=='B') {
+            open[track]++;
+        } else if(json.phases[i]!='E' || --open[track]<0) {
+            printf("  %s: event %d ends a span that didn't begin\n",when,(int)i);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** the trace dumps are valid Chrome trace JSON, also once the ring wrapped */
+static void testTrace() {
+    DogLcdhw lcd(0,0,PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    St7036Sim sim(PIN_CSB_DIRECT,PIN_RS_DIRECT);
+    lcd.begin(DOG_LCDhw_M162,DOG_LCDhw_VCC_3V3,-1,-1);
+    DogLcdTrace::clear();
+    CHECK(DogLcdTrace::count()==0);
+    DogLcdTrace::begin("say \"hi\"\\\n");
+    lcd.print("hi");
+    DogLcdTrace::end("say \"hi\"\\\n");
+    CHECK(traceValid("a call"));
+    StringPrint out;
+    DogLcdTrace::dump(out);
+    CHECK(out.text.find("\"name\":\"say \\\"hi\\\"\\\\\\u000a\"")!=std::string::npos);
+    CHECK(out.text.find("\"name\":\"write\"")!=std::string::npos);
+    // many times the buffer, from the middle of a call on
+    for(int n=0; n<20; n++) {
+        lcd.setCursor(0,n%2);
+        lcd.print("wrapping around");
+        lcd.createChar(n%8,arrowUp);
+    }
+    CHECK(DogLcdTrace::count()==DOG_LCDhw_TRACE_SIZE);
+    CHECK(traceValid("after wrapping"));
+    DogLcdTrace::clear();
+    CHECK(traceValid("empty"));
+}
+#endif
+
+struct Case {
+    const char *name;
+    void (*run)();
+};
+
+static const Case cases[]={
+    {"equivalence",testEquivalence},
+    {"setCursor_range",testSetCursorRange},
+    {"paced_dma",testPacedDma},
+    {"marquee",testMarquee},
+    {"flush_budget",testFlushBudget},
+    {"timing",testTiming},
+    {"bus",testBus},
+    {"group",testGroup},
+    {"glyphs",testGlyphs},
+    {"loadGlyphs",testLoadGlyphs},
+    {"animation",testAnimation},
+    {"pages",testPages},
+#if defined(DOG_LCDhw_STATS)
+    {"stats",testStats},
+#endif
+#if defined(DOG_LCDhw_TRACE)
+    {"trace",testTrace},
+#endif
+};
+
+int main(int argc, char **argv) {
+    int failed=0;
+    int ran=0;
+    for(size_t i=0; i<sizeof(cases)/sizeof(cases[0]); i++) {
+        bool wanted=(argc<2);
+        for(int k=1; k<argc; k++) {
+            if(strcmp(argv[k],cases[i].name)==0)
+                wanted=true;
+        }
+        if(!wanted)
+            continue;
+        casePassed=true;
+        cases[i].run();
+        printf("%-24s %s\n",cases[i].name,casePassed ? "ok" : "FAILED");
+        ran++;
+        if(!casePassed)
+            failed++;
+    }
+    printf("%d of %d cases failed\n",failed,ran);
+    return failed>0 ? 1 : 0;
+}
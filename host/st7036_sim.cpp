@@ -0,0 +1,227 @@
+/* dmf
+ * st7036_sim - a software model of the ST7036 controller
+ * See st7036_sim.h, command set from the ST7036 datasheet
+ * (http://www.lcd-module.de/eng/pdf/zubehoer/st7036.pdf)
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#include "st7036_sim.h"
+
+St7036Sim::St7036Sim(int lcdCSB, int lcdRS, int lcdSI, int lcdCLK) {
+    _csb=lcdCSB;
+    _rs=lcdRS;
+    _si=lcdSI;
+    _clk=lcdCLK;
+    checkTiming(0);
+    powerOn();
+    HostHal::attach(this);
+}
+
+St7036Sim::~St7036Sim() {
+    HostHal::detach(this);
+}
+
+void St7036Sim::powerOn() {
+    _shiftReg=0;
+    _bits=0;
+    // DDRAM content is undefined after power on, blanks are as good as anything
+    memset(_ddram, 0x20, sizeof(_ddram));
+    memset(_cgram, 0, sizeof(_cgram));
+    _ac=0;
+    _inCgram=false;
+    // 8 bit, 1 line, instruction table 0; display off; increment
+    _function=0x30;
+    _display=0x08;
+    _entry=0x06;
+    _bias=0x14;
+    _power=0x50;
+    _follower=0x60;
+    _contrast=0;
+    _shift=0;
+    _commands=0;
+    _data=0;
+    _busyUntilNs=0;
+}
+
+void St7036Sim::checkTiming(uint32_t fosc) {
+    _fosc=fosc;
+    _busyUntilNs=0;
+    _violations=0;
+    _worstViolationNs=0;
+}
+
+int St7036Sim::lines() const {
+    if((_function & 0x08)==0)
+        return 1;
+    // two line mode becomes three lines when FX is set in the bias command
+    if((_bias & 0x01) && (_function & 0x04)==0)
+        return 3;
+    return 2;
+}
+
+int St7036Sim::lineLength() const {
+    switch(lines()) {
+    case 1:
+        return 80;
+    case 2:
+        return 40;
+    default:
+        return 16;
+    }
+}
+
+int St7036Sim::lineStart(int row) const {
+    return lines()==2 ? row*0x40 : row*lineLength();
+}
+
+uint8_t St7036Sim::step(uint8_t address, bool up) const {
+    int n=lines();
+    int len=lineLength();
+    for(int row=0; row<n; row++) {
+        int start=lineStart(row);
+        if(address<start || address>=start+len)
+            continue;
+        int col=address-start;
+        if(up) {
+            if(++col<len)
+                return start+col;
+            return lineStart((row+1)%n);
+        }
+        if(--col>=0)
+            return start+col;
+        return lineStart((row+n-1)%n)+len-1;
+    }
+    // outside the line layout the counter simply counts
+    return (up ? address+1 : address-1) & 0x7F;
+}
+
+void St7036Sim::visibleLine(int row, int cols, char* buf) const {
+    int len=lineLength();
+    int start=lineStart(row);
+    for(int col=0; col<cols; col++) {
+        int pos=((col+_shift)%len+len)%len;
+        buf[col]=(char)_ddram[(start+pos) & 0x7F];
+    }
+    buf[cols]=0;
+}
+
+void St7036Sim::pinChanged(int pin, int value) {
+    if(pin==_csb) {
+        // a new transfer starts whenever CSB is asserted
+        _bits=0;
+        return;
+    }
+    if(pin!=_clk || value!=HIGH || HostHal::pin(_csb)!=LOW)
+        return;
+    // software SPI: SI is sampled on the rising edge of CLK
+    _shiftReg=(_shiftReg<<1) | (HostHal::pin(_si) ? 1 : 0);
+    if(++_bits==8) {
+        _bits=0;
+        receive(_shiftReg, HostHal::pin(_rs)==HIGH);
+    }
+}
+
+void St7036Sim::spiByte(uint8_t value) {
+    if(HostHal::pin(_csb)!=LOW)
+        return;
+    receive(value, HostHal::pin(_rs)==HIGH);
+}
+
+void St7036Sim::receive(uint8_t value, bool rs) {
+    if(_fosc!=0) {
+        uint64_t now=HostHal::nowNs();
+        if(now<_busyUntilNs) {
+            _violations++;
+            if(_busyUntilNs-now>_worstViolationNs)
+                _worstViolationNs=_busyUntilNs-now;
+        }
+        // clear display and return home, the rest take 10 clocks
+        uint32_t clocks=(!rs && value>=0x01 && value<=0x03) ? 410 : 10;
+        _busyUntilNs=now+(uint64_t)clocks*1000000000ULL/_fosc;
+    }
+    if(rs) {
+        _data++;
+        writeData(value);
+    } else {
+        _commands++;
+        command(value);
+    }
+}
+
+void St7036Sim::writeData(uint8_t value) {
+    bool up=(_entry & 0x02)!=0;
+    if(_inCgram) {
+        _cgram[_ac & 0x3F]=value & 0x1F;
+        _ac=(up ? _ac+1 : _ac-1) & 0x3F;
+        return;
+    }
+    _ddram[_ac & 0x7F]=value;
+    _ac=step(_ac, up);
+    // entry mode S: the display follows the cursor
+    if(_entry & 0x01)
+        _shift+=up ? 1 : -1;
+}
+
+void St7036Sim::command(uint8_t cmd) {
+    int table=instructionTable();
+    if(cmd & 0x80) {
+        // set DDRAM address, all tables
+        _ac=cmd & 0x7F;
+        _inCgram=false;
+    } else if(cmd & 0x40) {
+        if(table==0) {
+            // set CGRAM address
+            _ac=cmd & 0x3F;
+            _inCgram=true;
+        } else if(table==1) {
+            if((cmd & 0xF0)==0x50) {
+                // power/icon control/contrast high bits
+                _power=cmd;
+                _contrast=(_contrast & 0x0F) | ((cmd & 0x03)<<4);
+            } else if((cmd & 0xF0)==0x60) {
+                _follower=cmd;
+            } else if((cmd & 0xF0)==0x70) {
+                _contrast=(_contrast & 0x30) | (cmd & 0x0F);
+            }
+            // 0x40..0x4F sets the icon address, icons are not modeled
+        }
+    } else if(cmd & 0x20) {
+        _function=cmd;
+    } else if(cmd & 0x10) {
+        if(table==0) {
+            if(cmd & 0x08) {
+                // display shift, right moves the content right
+                _shift+=(cmd & 0x04) ? -1 : 1;
+            } else {
+                // cursor shift
+                _ac=step(_ac, (cmd & 0x04)!=0);
+            }
+        } else if(table==1) {
+            _bias=cmd;
+        }
+        // table 2: double height position, not modeled
+    } else if(cmd & 0x08) {
+        _display=cmd;
+    } else if(cmd & 0x04) {
+        _entry=cmd;
+    } else if(cmd & 0x02) {
+        // return home
+        _ac=0;
+        _inCgram=false;
+        _shift=0;
+    } else if(cmd & 0x01) {
+        // clear display
+        memset(_ddram, 0x20, sizeof(_ddram));
+        _ac=0;
+        _inCgram=false;
+        _entry|=0x02;
+        _shift=0;
+    }
+}
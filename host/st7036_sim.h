@@ -0,0 +1,132 @@
+/* dmf
+ * st7036_sim - a software model of the Sitronix ST7036 controller used
+ * on the EA DOGM displays, for the host backend (see hal_host.h).
+ *
+ * The model listens to the pins of one display (CSB, RS and, for
+ * software SPI, SI and CLK) and to the hardware SPI, and executes what
+ * it receives: instruction tables 0-2, the DDRAM/CGRAM address counter,
+ * entry mode, display on/off and display shift. Its state can be
+ * inspected to check what a real display would show.
+ *
+ * With checkTiming() it also flags every byte that arrives before the
+ * controller has executed the previous one, by the execution times of
+ * the datasheet for a given oscillator frequency.
+ */
+/*
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Copyright 2015 Douglas Freymann <jaldilabs@gmail.com>
+ */
+
+#ifndef do_ST7036_SIM_h
+#define do_ST7036_SIM_h
+
+#include "hal_host.h"
+
+class St7036Sim : public HostDevice {
+ public:
+    /**
+     * Creates a display model listening on the given pins.
+     * @param lcdCSB the chip select pin of the display
+     * @param lcdRS the register select pin of the display
+     * @param lcdSI the serial data pin, only needed for software SPI
+     * @param lcdCLK the serial clock pin, only needed for software SPI
+     */
+    St7036Sim(int lcdCSB, int lcdRS, int lcdSI=-1, int lcdCLK=-1);
+    ~St7036Sim();
+
+    /** put the controller into its power-on state */
+    void powerOn();
+
+    /** the DDRAM, 0x00..0x7F */
+    uint8_t ddram(int address) const { return _ddram[address & 0x7F]; }
+    /** the CGRAM, 0x00..0x3F (5 bits per row) */
+    uint8_t cgram(int address) const { return _cgram[address & 0x3F]; }
+    /** the address counter and whether it points into CGRAM */
+    uint8_t addressCounter() const { return _ac; }
+    bool inCgram() const { return _inCgram; }
+    /** the instruction table selected by the last function set */
+    int instructionTable() const { return _function & 0x03; }
+    uint8_t functionSet() const { return _function; }
+    uint8_t entryMode() const { return _entry; }
+    uint8_t displayControl() const { return _display; }
+    /** the display shift, in cells to the left */
+    int displayShift() const { return _shift; }
+    /** the 6 bit contrast from the power/contrast commands */
+    int contrast() const { return _contrast; }
+    /** the 3 bit amplification ratio from follower control */
+    int gain() const { return _follower & 0x07; }
+    bool boosterOn() const { return (_power & 0x04)!=0; }
+    uint8_t biasAndFx() const { return _bias; }
+
+    /** number of display lines the controller is configured for (1..3) */
+    int lines() const;
+
+    /**
+     * The characters visible on a line, after display shift.
+     * @param row the line
+     * @param cols the number of visible columns
+     * @param buf receives cols characters and a terminating 0
+     */
+    void visibleLine(int row, int cols, char* buf) const;
+
+    /**
+     * Check that every byte arrives after the previous one has been
+     * executed: clear display and return home take 410 oscillator
+     * clocks, all other instructions and data writes 10 (1.08ms and
+     * 26.3us at 380kHz).
+     * @param fosc the oscillator frequency in Hz, 0 switches the check off
+     */
+    void checkTiming(uint32_t fosc);
+    /** bytes that arrived too early since checkTiming() */
+    uint32_t violations() const { return _violations; }
+    /** how much too early the worst of them was, in ns */
+    uint64_t worstViolationNs() const { return _worstViolationNs; }
+
+    /** bytes received since powerOn(), by RS */
+    uint32_t commands() const { return _commands; }
+    uint32_t data() const { return _data; }
+
+    virtual void pinChanged(int pin, int value);
+    virtual void spiByte(uint8_t value);
+
+ private:
+    void receive(uint8_t value, bool rs);
+    void command(uint8_t cmd);
+    void writeData(uint8_t value);
+    /** the DDRAM address following address in the current layout */
+    uint8_t step(uint8_t address, bool up) const;
+    /** the length of a line in the current layout */
+    int lineLength() const;
+    int lineStart(int row) const;
+
+    int _csb, _rs, _si, _clk;
+    uint8_t _shiftReg;
+    int _bits;
+
+    uint8_t _ddram[128];
+    uint8_t _cgram[64];
+    uint8_t _ac;
+    bool _inCgram;
+    uint8_t _function;
+    uint8_t _entry;
+    uint8_t _display;
+    uint8_t _bias;
+    uint8_t _power;
+    uint8_t _follower;
+    int _contrast;
+    int _shift;
+    uint32_t _commands;
+    uint32_t _data;
+
+    uint32_t _fosc;
+    /** when the controller has executed the last byte, in ns */
+    uint64_t _busyUntilNs;
+    uint32_t _violations;
+    uint64_t _worstViolationNs;
+};
+
+#endif